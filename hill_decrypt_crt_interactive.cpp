@@ -1,8 +1,10 @@
 // hill_decrypt_crt_interactive.cpp
 // 3x3 Hill cipher decryption using Chinese Remainder Theorem (mod 2 and mod 13 -> mod 26)
 // Interactive: reads key and ciphertext from user input.
-// Compile: g++ -std=c++17 -O2 hill_decrypt_crt_interactive.cpp -o hill_decrypt
-// Run:   ./hill_decrypt
+// Compile: g++ -std=c++17 -O2 -pthread hill_decrypt_crt_interactive.cpp -o hill_decrypt
+// Run:   ./hill_decrypt                       (interactive)
+//        ./hill_decrypt --stream --key KEY < cipher.txt > plain.txt
+//        ./hill_decrypt --mmap --key KEY --input cipher.txt --output plain.txt
 //
 // Example interactive session:
 // Enter 9-letter key (row-major): GYBNQKURP
@@ -10,6 +12,22 @@
 // Decrypted plaintext (uppercase): ACT
 
 #include <bits/stdc++.h>
+#if defined(__unix__) || defined(__APPLE__)
+#define HILL_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HILL_HAVE_X86_KERNELS 1
+// GCC 12's AVX-512 headers build their pass-through operands from self-initialized variables,
+// which -Wmaybe-uninitialized reports inside every kernel that inlines them (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#endif
 using namespace std;
 
 const string ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
@@ -20,18 +38,41 @@ using Matrix3x3 = array<array<int,3>,3>;
 
 // ---------- Utility functions ----------
 int letterIndex(char c) {
-    return (int)ALPHABET.find(c);
+    return (c >= 'A' && c <= 'Z') ? c - 'A' : -1;
 }
 
-string keepLettersUpper(const string &s) {
-    string out;
-    out.reserve(s.size());
-    for (char ch : s) {
-        if (isalpha((unsigned char)ch)) out.push_back((char)toupper((unsigned char)ch));
+// 256-entry byte classifier: letter index 0-25 for A-Z and a-z, NOT_A_LETTER for every other byte
+const uint8_t NOT_A_LETTER = 0xFF;
+
+struct LetterIndexTable {
+    uint8_t index[256];
+
+    LetterIndexTable() {
+        for (int ch = 0; ch < 256; ++ch) index[ch] = NOT_A_LETTER;
+        for (int i = 0; i < MOD_26; ++i) {
+            index['A' + i] = (uint8_t)i;
+            index['a' + i] = (uint8_t)i;
+        }
     }
-    return out;
+
+    uint8_t operator[](char ch) const { return index[(unsigned char)ch]; }
+};
+const LetterIndexTable LETTER_INDEX_TABLE;
+
+// Write the alphabetic characters of data[0..size) to out, uppercased; returns how many were written.
+// Branch-free, so out[count..size) may be overwritten as well.
+size_t compactLettersUpperScalar(const char *data, size_t size, char *out) {
+    size_t count = 0;
+    for (size_t k = 0; k < size; ++k) {
+        uint8_t index = LETTER_INDEX_TABLE[data[k]];
+        out[count] = (char)('A' + index);       // overwritten by the next letter when not a letter
+        count += index != NOT_A_LETTER;
+    }
+    return count;
 }
 
+string keepLettersUpper(const string &s);
+
 int positiveMod(int value, int mod) {
     int r = value % mod;
     if (r < 0) r += mod;
@@ -71,6 +112,13 @@ Matrix3x3 createKeyMatrixFromString(const string &keyString) {
     return mat;
 }
 
+// Inverse of createKeyMatrixFromString: row-major letters of a matrix with entries reduced mod 26
+string matrixToKeyString(const Matrix3x3 &m) {
+    string key(9, 'A');
+    for (int i = 0; i < 9; ++i) key[i] = ALPHABET[positiveMod(m[i/3][i%3], MOD_26)];
+    return key;
+}
+
 int determinant3x3(const Matrix3x3 &m) {
     int a = m[0][0], b = m[0][1], c = m[0][2];
     int d = m[1][0], e = m[1][1], f = m[1][2];
@@ -175,8 +223,867 @@ array<int,3> multiplyMatrixVectorMod(const Matrix3x3 &matrix, const array<int,3>
     return result;
 }
 
+// ---------- CPU features ----------
+#ifdef HILL_HAVE_X86_KERNELS
+bool cpuSupportsSse41() {
+    static const bool supported = __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+
+bool cpuSupportsAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+bool cpuSupportsAvx512Bw() {
+    static const bool supported = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    return supported;
+}
+
+bool cpuSupportsAvx512Vbmi() {
+    static const bool supported = cpuSupportsAvx512Bw() && __builtin_cpu_supports("avx512vbmi");
+    return supported;
+}
+
+bool cpuSupportsAvx512Vbmi2() {
+    static const bool supported = cpuSupportsAvx512Bw() && __builtin_cpu_supports("avx512vbmi2");
+    return supported;
+}
+#endif
+
+// ---------- Letter compaction kernels ----------
+// All kernels classify, case-fold and left-pack a whole register of bytes per iteration:
+//   folded = (byte | 0x20) - 'a' is 0-25 exactly for A-Z/a-z, so one unsigned compare classifies
+//   the byte and folded + 'A' is its uppercase form. The pshufb left-pack stores all 8 bytes of a
+//   group at out + count, so bytes past the returned count may be overwritten. Every store stays
+//   within out[0..size), though: callers need room for size bytes and must not keep other data in
+//   that range (WindowDecryptor gives each partition its own scratch buffer for this reason).
+#ifdef HILL_HAVE_X86_KERNELS
+// pshufb masks left-packing the set bytes of an 8-bit mask, 8 bytes per entry
+struct LeftPackMasks {
+    alignas(8) uint8_t shuffle[256][8];
+
+    LeftPackMasks() {
+        for (int mask = 0; mask < 256; ++mask) {
+            int n = 0;
+            for (int bit = 0; bit < 8; ++bit)
+                if (mask & (1 << bit)) shuffle[mask][n++] = (uint8_t)bit;
+            while (n < 8) shuffle[mask][n++] = 0x80;
+        }
+    }
+};
+const LeftPackMasks LEFT_PACK_MASKS;
+
+// Left-pack the letters of one 8-byte group (bytes `base`..`base`+7 of `upper`) selected by mask8
+__attribute__((target("sse4.1")))
+static inline size_t leftPack8(__m128i upper, unsigned mask8, int base, char *out) {
+    __m128i shuffle = _mm_loadl_epi64((const __m128i *)LEFT_PACK_MASKS.shuffle[mask8]);
+    shuffle = _mm_add_epi8(shuffle, _mm_set1_epi8((char)base));   // 0x80 lanes stay negative
+    _mm_storel_epi64((__m128i *)out, _mm_shuffle_epi8(upper, shuffle));
+    return (size_t)__builtin_popcount(mask8);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i classifyLetters16(__m128i bytes, __m128i &upper) {
+    __m128i folded = _mm_sub_epi8(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    upper = _mm_add_epi8(folded, _mm_set1_epi8('A'));
+    return _mm_cmpeq_epi8(_mm_min_epu8(folded, _mm_set1_epi8(25)), folded);
+}
+
+__attribute__((target("sse4.1")))
+size_t compactLettersUpperSse41(const char *data, size_t size, char *out) {
+    size_t count = 0, k = 0;
+    for (; k + 16 <= size; k += 16) {
+        __m128i upper;
+        __m128i isLetter = classifyLetters16(_mm_loadu_si128((const __m128i *)(data + k)), upper);
+        unsigned mask = (unsigned)_mm_movemask_epi8(isLetter);
+        count += leftPack8(upper, mask & 0xFF, 0, out + count);
+        count += leftPack8(upper, mask >> 8, 8, out + count);
+    }
+    return count + compactLettersUpperScalar(data + k, size - k, out + count);
+}
+
+__attribute__((target("avx2")))
+size_t compactLettersUpperAvx2(const char *data, size_t size, char *out) {
+    const __m256i caseBit = _mm256_set1_epi8(0x20), letterA = _mm256_set1_epi8('a');
+    const __m256i maxIndex = _mm256_set1_epi8(25), upperA = _mm256_set1_epi8('A');
+    size_t count = 0, k = 0;
+    for (; k + 32 <= size; k += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(data + k));
+        __m256i folded = _mm256_sub_epi8(_mm256_or_si256(bytes, caseBit), letterA);
+        __m256i upper = _mm256_add_epi8(folded, upperA);
+        __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(folded, maxIndex), folded);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(isLetter);
+        __m128i low = _mm256_castsi256_si128(upper), high = _mm256_extracti128_si256(upper, 1);
+        count += leftPack8(low, mask & 0xFF, 0, out + count);
+        count += leftPack8(low, (mask >> 8) & 0xFF, 8, out + count);
+        count += leftPack8(high, (mask >> 16) & 0xFF, 0, out + count);
+        count += leftPack8(high, mask >> 24, 8, out + count);
+    }
+    return count + compactLettersUpperScalar(data + k, size - k, out + count);
+}
+
+// AVX-512BW: classify 64 bytes into a mask register, then left-pack 8-byte groups with pshufb
+__attribute__((target("avx512f,avx512bw")))
+size_t compactLettersUpperAvx512Bw(const char *data, size_t size, char *out) {
+    const __m512i caseBit = _mm512_set1_epi8(0x20), letterA = _mm512_set1_epi8('a');
+    const __m512i maxIndex = _mm512_set1_epi8(25), upperA = _mm512_set1_epi8('A');
+    size_t count = 0, k = 0;
+    for (; k + 64 <= size; k += 64) {
+        __m512i bytes = _mm512_loadu_si512((const void *)(data + k));
+        __m512i folded = _mm512_sub_epi8(_mm512_or_si512(bytes, caseBit), letterA);
+        uint64_t mask = _mm512_cmple_epu8_mask(folded, maxIndex);
+        __m512i upper = _mm512_add_epi8(folded, upperA);
+        __m256i low = _mm512_castsi512_si256(upper), high = _mm512_extracti64x4_epi64(upper, 1);
+        __m128i lanes[4] = {_mm256_castsi256_si128(low), _mm256_extracti128_si256(low, 1),
+                            _mm256_castsi256_si128(high), _mm256_extracti128_si256(high, 1)};
+        for (int group = 0; group < 8; ++group)
+            count += leftPack8(lanes[group / 2], (unsigned)(mask >> (8 * group)) & 0xFF, 8 * (group % 2), out + count);
+    }
+    return count + compactLettersUpperScalar(data + k, size - k, out + count);
+}
+
+// AVX-512 VBMI2: vpcompressb packs the letters of 64 bytes in one instruction
+__attribute__((target("avx512f,avx512bw,avx512vbmi2")))
+size_t compactLettersUpperVbmi2(const char *data, size_t size, char *out) {
+    const __m512i caseBit = _mm512_set1_epi8(0x20), letterA = _mm512_set1_epi8('a');
+    const __m512i maxIndex = _mm512_set1_epi8(25), upperA = _mm512_set1_epi8('A');
+    size_t count = 0, k = 0;
+    for (; k + 64 <= size; k += 64) {
+        __m512i bytes = _mm512_loadu_si512((const void *)(data + k));
+        __m512i folded = _mm512_sub_epi8(_mm512_or_si512(bytes, caseBit), letterA);
+        __mmask64 isLetter = _mm512_cmple_epu8_mask(folded, maxIndex);
+        __m512i packed = _mm512_maskz_compress_epi8(isLetter, _mm512_add_epi8(folded, upperA));
+        size_t letterCount = (size_t)__builtin_popcountll(isLetter);
+        __mmask64 storeMask = letterCount == 64 ? ~0ULL : (1ULL << letterCount) - 1;
+        _mm512_mask_storeu_epi8((void *)(out + count), storeMask, packed);      // exactly the packed letters
+        count += letterCount;
+    }
+    return count + compactLettersUpperScalar(data + k, size - k, out + count);
+}
+
+// The vbmi kernel level compacts with vpcompressb when VBMI2 is present as well
+size_t compactLettersUpperAvx512Vbmi(const char *data, size_t size, char *out) {
+    if (cpuSupportsAvx512Vbmi2()) return compactLettersUpperVbmi2(data, size, out);
+    return compactLettersUpperAvx512Bw(data, size, out);
+}
+#endif
+
+// ---------- Block decryption kernels ----------
+// Scalar reference kernel: decrypt blockCount 3-letter blocks of cleaned (A-Z) ciphertext into out
+void decryptBlocksScalar(const char *cleanLetters, size_t blockCount, const Matrix3x3 &inverseKeyMatrix, char *out) {
+    for (size_t b = 0; b < blockCount; ++b) {
+        const char *block = cleanLetters + 3 * b;
+        array<int,3> blockVector;
+        for (int j = 0; j < 3; ++j) blockVector[j] = letterIndex(block[j]);
+        array<int,3> plainVector = multiplyMatrixVectorMod(inverseKeyMatrix, blockVector, MOD_26);
+        for (int j = 0; j < 3; ++j) out[3 * b + j] = ALPHABET[ plainVector[j] ];
+    }
+}
+
+#ifdef HILL_HAVE_X86_KERNELS
+// floor(x / 26) == (x * 2521) >> 16 for every 0 <= x < 6553; block sums are at most 3 * 25 * 25 = 1875
+const int MOD_26_RECIPROCAL_16 = 2521;
+
+// pshufb masks moving 16 interleaved 3-letter blocks (48 bytes in three registers) to one
+// register per block position and back again
+struct BlockShuffleMasks {
+    alignas(16) uint8_t deinterleave[3][3][16];  // [block position][source register][byte]
+    alignas(16) uint8_t interleave[3][3][16];    // [destination register][block position][byte]
+
+    BlockShuffleMasks() {
+        for (int j = 0; j < 3; ++j)
+            for (int src = 0; src < 3; ++src)
+                for (int p = 0; p < 16; ++p) {
+                    int byteIndex = 3 * p + j;
+                    deinterleave[j][src][p] = (byteIndex / 16 == src) ? (uint8_t)(byteIndex % 16) : 0x80;
+                }
+        for (int dst = 0; dst < 3; ++dst)
+            for (int j = 0; j < 3; ++j)
+                for (int q = 0; q < 16; ++q) {
+                    int byteIndex = 16 * dst + q;
+                    interleave[dst][j][q] = (byteIndex % 3 == j) ? (uint8_t)(byteIndex / 3) : 0x80;
+                }
+    }
+};
+const BlockShuffleMasks BLOCK_SHUFFLE_MASKS;
+
+// Load 16 blocks (48 letters) and split them into one register of letter indices per block position
+__attribute__((target("sse4.1")))
+static inline void deinterleave16Blocks(const char *in, __m128i (&column)[3]) {
+    const __m128i letterA = _mm_set1_epi8('A');
+    __m128i raw[3];
+    for (int src = 0; src < 3; ++src)
+        raw[src] = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)(in + 16 * src)), letterA);
+    for (int j = 0; j < 3; ++j) {
+        __m128i gathered = _mm_setzero_si128();
+        for (int src = 0; src < 3; ++src)
+            gathered = _mm_or_si128(gathered, _mm_shuffle_epi8(raw[src],
+                _mm_load_si128((const __m128i *)BLOCK_SHUFFLE_MASKS.deinterleave[j][src])));
+        column[j] = gathered;
+    }
+}
+
+// Inverse of deinterleave16Blocks: turn per-position plaintext indices back into 48 letters
+__attribute__((target("sse4.1")))
+static inline void interleave16Blocks(const __m128i (&plain)[3], char *out) {
+    const __m128i letterA = _mm_set1_epi8('A');
+    for (int dst = 0; dst < 3; ++dst) {
+        __m128i merged = _mm_setzero_si128();
+        for (int j = 0; j < 3; ++j)
+            merged = _mm_or_si128(merged, _mm_shuffle_epi8(plain[j],
+                _mm_load_si128((const __m128i *)BLOCK_SHUFFLE_MASKS.interleave[dst][j])));
+        _mm_storeu_si128((__m128i *)(out + 16 * dst), _mm_add_epi8(merged, letterA));
+    }
+}
+
+// Row r of the 3x3 product on 16-bit lanes, reduced mod 26 by multiply-high
+__attribute__((target("sse4.1")))
+static inline __m128i rowResidueSse41(const __m128i (&key)[3][3], int r, const __m128i (&x)[3]) {
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(key[r][0], x[0]), _mm_mullo_epi16(key[r][1], x[1])),
+                                _mm_mullo_epi16(key[r][2], x[2]));
+    __m128i quotient = _mm_mulhi_epu16(sum, _mm_set1_epi16(MOD_26_RECIPROCAL_16));
+    return _mm_sub_epi16(sum, _mm_mullo_epi16(quotient, _mm_set1_epi16(MOD_26)));
+}
+
+// SSE4.1 kernel: 16 blocks per iteration as two halves of 8 16-bit lanes
+__attribute__((target("sse4.1")))
+void decryptBlocksSse41(const char *cleanLetters, size_t blockCount, const Matrix3x3 &inverseKeyMatrix, char *out) {
+    __m128i key[3][3];
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+            key[r][c] = _mm_set1_epi16((short)positiveMod(inverseKeyMatrix[r][c], MOD_26));
+
+    size_t b = 0;
+    for (; b + 16 <= blockCount; b += 16) {
+        __m128i column[3], low[3], high[3], plain[3];
+        deinterleave16Blocks(cleanLetters + 3 * b, column);
+        for (int j = 0; j < 3; ++j) {
+            low[j] = _mm_cvtepu8_epi16(column[j]);
+            high[j] = _mm_cvtepu8_epi16(_mm_srli_si128(column[j], 8));
+        }
+        for (int r = 0; r < 3; ++r)
+            plain[r] = _mm_packus_epi16(rowResidueSse41(key, r, low), rowResidueSse41(key, r, high));
+        interleave16Blocks(plain, out + 3 * b);
+    }
+    decryptBlocksScalar(cleanLetters + 3 * b, blockCount - b, inverseKeyMatrix, out + 3 * b);
+}
+
+__attribute__((target("avx2")))
+static inline void decrypt16BlocksAvx2(const char *in, char *out, const __m256i (&key)[3][3]) {
+    const __m256i reciprocal = _mm256_set1_epi16(MOD_26_RECIPROCAL_16);
+    const __m256i modulus = _mm256_set1_epi16(MOD_26);
+
+    // de-interleave into one 16-bit lane per block for each block position
+    __m128i gathered[3];
+    deinterleave16Blocks(in, gathered);
+    __m256i column[3];
+    for (int j = 0; j < 3; ++j) column[j] = _mm256_cvtepu8_epi16(gathered[j]);
+
+    __m128i plain[3];
+    for (int r = 0; r < 3; ++r) {
+        __m256i sum = _mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(key[r][0], column[0]),
+            _mm256_mullo_epi16(key[r][1], column[1])),
+            _mm256_mullo_epi16(key[r][2], column[2]));
+        __m256i quotient = _mm256_mulhi_epu16(sum, reciprocal);
+        __m256i residue = _mm256_sub_epi16(sum, _mm256_mullo_epi16(quotient, modulus));
+        plain[r] = _mm_packus_epi16(_mm256_castsi256_si128(residue), _mm256_extracti128_si256(residue, 1));
+    }
+
+    // re-interleave the three plaintext positions back into 48 output bytes
+    interleave16Blocks(plain, out);
+}
+
+// AVX2 kernel: 32 blocks (96 bytes) per iteration on 16-bit lanes with multiply-high reduction mod 26
+__attribute__((target("avx2")))
+void decryptBlocksAvx2(const char *cleanLetters, size_t blockCount, const Matrix3x3 &inverseKeyMatrix, char *out) {
+    __m256i key[3][3];
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+            key[r][c] = _mm256_set1_epi16((short)positiveMod(inverseKeyMatrix[r][c], MOD_26));
+
+    size_t b = 0;
+    for (; b + 32 <= blockCount; b += 32) {
+        decrypt16BlocksAvx2(cleanLetters + 3 * b, out + 3 * b, key);
+        decrypt16BlocksAvx2(cleanLetters + 3 * b + 48, out + 3 * b + 48, key);
+    }
+    for (; b + 16 <= blockCount; b += 16)
+        decrypt16BlocksAvx2(cleanLetters + 3 * b, out + 3 * b, key);
+    decryptBlocksScalar(cleanLetters + 3 * b, blockCount - b, inverseKeyMatrix, out + 3 * b);
+}
+
+// Row r of the 3x3 product on 32 16-bit lanes, reduced mod 26 and narrowed to bytes
+__attribute__((target("avx512f,avx512bw")))
+static inline __m256i rowResidueAvx512(const __m512i (&key)[3][3], int r, const __m512i (&x)[3]) {
+    __m512i sum = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(key[r][0], x[0]),
+                                                    _mm512_mullo_epi16(key[r][1], x[1])),
+                                   _mm512_mullo_epi16(key[r][2], x[2]));
+    __m512i quotient = _mm512_mulhi_epu16(sum, _mm512_set1_epi16(MOD_26_RECIPROCAL_16));
+    return _mm512_cvtepi16_epi8(_mm512_sub_epi16(sum, _mm512_mullo_epi16(quotient, _mm512_set1_epi16(MOD_26))));
+}
+
+// AVX-512BW kernel: 32 blocks per 512-bit operation, de-interleaved 16 blocks at a time with pshufb
+__attribute__((target("avx512f,avx512bw")))
+void decryptBlocksAvx512Bw(const char *cleanLetters, size_t blockCount, const Matrix3x3 &inverseKeyMatrix, char *out) {
+    __m512i key[3][3];
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+            key[r][c] = _mm512_set1_epi16((short)positiveMod(inverseKeyMatrix[r][c], MOD_26));
+
+    size_t b = 0;
+    for (; b + 32 <= blockCount; b += 32) {
+        __m128i low[3], high[3];
+        deinterleave16Blocks(cleanLetters + 3 * b, low);
+        deinterleave16Blocks(cleanLetters + 3 * b + 48, high);
+        __m512i column[3];
+        for (int j = 0; j < 3; ++j)
+            column[j] = _mm512_cvtepu8_epi16(_mm256_inserti128_si256(_mm256_castsi128_si256(low[j]), high[j], 1));
+        __m128i plainLow[3], plainHigh[3];
+        for (int r = 0; r < 3; ++r) {
+            __m256i plain = rowResidueAvx512(key, r, column);
+            plainLow[r] = _mm256_castsi256_si128(plain);
+            plainHigh[r] = _mm256_extracti128_si256(plain, 1);
+        }
+        interleave16Blocks(plainLow, out + 3 * b);
+        interleave16Blocks(plainHigh, out + 3 * b + 48);
+    }
+    decryptBlocksSse41(cleanLetters + 3 * b, blockCount - b, inverseKeyMatrix, out + 3 * b);
+}
+
+// vpermb/vpermt2b index vectors (de-)interleaving 64 blocks held in three 64-byte registers
+struct VbmiBlockPermutes {
+    alignas(64) uint8_t gather[3][64];   // [block position][block]: byte 3p+j as a two-register index
+    alignas(64) uint8_t scatter[3][64];  // [destination register][byte]: index into positions 0-1
+    uint64_t gatherFromThird[3];         // blocks whose byte lives in the third input register
+    uint64_t scatterFromThird[3];        // output bytes taken from block position 2
+
+    VbmiBlockPermutes() {
+        for (int j = 0; j < 3; ++j) {
+            gatherFromThird[j] = 0;
+            for (int p = 0; p < 64; ++p) {
+                int byteIndex = 3 * p + j;
+                gather[j][p] = (uint8_t)(byteIndex & 127);
+                if (byteIndex >= 128) gatherFromThird[j] |= 1ULL << p;
+            }
+        }
+        for (int dst = 0; dst < 3; ++dst) {
+            scatterFromThird[dst] = 0;
+            for (int q = 0; q < 64; ++q) {
+                int byteIndex = 64 * dst + q, p = byteIndex / 3, j = byteIndex % 3;
+                scatter[dst][q] = (uint8_t)(j == 1 ? 64 + p : p);
+                if (j == 2) scatterFromThird[dst] |= 1ULL << q;
+            }
+        }
+    }
+};
+const VbmiBlockPermutes VBMI_BLOCK_PERMUTES;
+
+// AVX-512 VBMI kernel: 64 blocks (192 bytes) per iteration, de-interleaved with byte permutes
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+void decryptBlocksVbmi(const char *cleanLetters, size_t blockCount, const Matrix3x3 &inverseKeyMatrix, char *out) {
+    __m512i key[3][3];
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+            key[r][c] = _mm512_set1_epi16((short)positiveMod(inverseKeyMatrix[r][c], MOD_26));
+    const __m512i letterA = _mm512_set1_epi8('A');
+
+    size_t b = 0;
+    for (; b + 64 <= blockCount; b += 64) {
+        const char *in = cleanLetters + 3 * b;
+        __m512i raw[3];
+        for (int src = 0; src < 3; ++src)
+            raw[src] = _mm512_sub_epi8(_mm512_loadu_si512((const void *)(in + 64 * src)), letterA);
+
+        __m512i low[3], high[3];
+        for (int j = 0; j < 3; ++j) {
+            __m512i index = _mm512_load_si512((const void *)VBMI_BLOCK_PERMUTES.gather[j]);
+            __m512i column = _mm512_mask_permutexvar_epi8(_mm512_permutex2var_epi8(raw[0], index, raw[1]),
+                                                          VBMI_BLOCK_PERMUTES.gatherFromThird[j], index, raw[2]);
+            low[j] = _mm512_cvtepu8_epi16(_mm512_castsi512_si256(column));
+            high[j] = _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(column, 1));
+        }
+
+        __m512i plain[3];
+        for (int r = 0; r < 3; ++r)
+            plain[r] = _mm512_inserti64x4(_mm512_castsi256_si512(rowResidueAvx512(key, r, low)),
+                                          rowResidueAvx512(key, r, high), 1);
+
+        for (int dst = 0; dst < 3; ++dst) {
+            __m512i index = _mm512_load_si512((const void *)VBMI_BLOCK_PERMUTES.scatter[dst]);
+            __m512i merged = _mm512_mask_permutexvar_epi8(_mm512_permutex2var_epi8(plain[0], index, plain[1]),
+                                                          VBMI_BLOCK_PERMUTES.scatterFromThird[dst], index, plain[2]);
+            _mm512_storeu_si512((void *)(out + 3 * b + 64 * dst), _mm512_add_epi8(merged, letterA));
+        }
+    }
+    decryptBlocksAvx512Bw(cleanLetters + 3 * b, blockCount - b, inverseKeyMatrix, out + 3 * b);
+}
+#endif
+
+// ---------- Quadgram scoring kernels ----------
+// Sum of table[code] over the quadgram codes l[i]*26^3 + l[i+1]*26^2 + l[i+2]*26 + l[i+3] of a
+// letter-index sequence. Tables end with QUADGRAM_PADDING_ENTRIES spare entries because the
+// gather kernel reads 32 bits at every entry.
+const int QUADGRAM_COUNT = 26 * 26 * 26 * 26;
+const int QUADGRAM_PADDING_ENTRIES = 32;
+
+int64_t scoreQuadgramsScalar(const int16_t *table, const uint8_t *letters, size_t size) {
+    if (size < 4) return 0;
+    int64_t total = 0;
+    int code = (letters[0] * 26 + letters[1]) * 26 + letters[2];
+    for (size_t i = 3; i < size; ++i) {
+        code = code % (26 * 26 * 26) * 26 + letters[i];
+        total += table[code];
+    }
+    return total;
+}
+
+#ifdef HILL_HAVE_X86_KERNELS
+// 8 quadgram codes per iteration from four overlapping byte loads, looked up with one 32-bit
+// gather; the upper half of each gathered word belongs to the next entry and is shifted out.
+// Lane sums are flushed every QUADGRAM_FLUSH_ITERATIONS so they cannot overflow 32 bits.
+const size_t QUADGRAM_FLUSH_ITERATIONS = 4096;
+
+__attribute__((target("avx2")))
+int64_t scoreQuadgramsAvx2(const int16_t *table, const uint8_t *letters, size_t size) {
+    if (size < 4) return 0;
+    const __m256i weight0 = _mm256_set1_epi32(26 * 26 * 26), weight1 = _mm256_set1_epi32(26 * 26);
+    const __m256i weight2 = _mm256_set1_epi32(26), allLanes = _mm256_set1_epi32(-1);
+    size_t quadgrams = size - 3, i = 0;
+    int64_t total = 0;
+    while (i + 8 <= quadgrams) {
+        __m256i sum = _mm256_setzero_si256();
+        size_t end = min(quadgrams, i + 8 * QUADGRAM_FLUSH_ITERATIONS);
+        for (; i + 8 <= end; i += 8) {
+            __m256i l0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(letters + i)));
+            __m256i l1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(letters + i + 1)));
+            __m256i l2 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(letters + i + 2)));
+            __m256i l3 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(letters + i + 3)));
+            __m256i code = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(l0, weight0), _mm256_mullo_epi32(l1, weight1)),
+                                            _mm256_add_epi32(_mm256_mullo_epi32(l2, weight2), l3));
+            __m256i gathered = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)table, code, allLanes, 2);
+            sum = _mm256_add_epi32(sum, _mm256_srai_epi32(_mm256_slli_epi32(gathered, 16), 16));
+        }
+        alignas(32) int32_t lanes[8];
+        _mm256_store_si256((__m256i *)lanes, sum);
+        for (int32_t lane : lanes) total += lane;
+    }
+    return total + scoreQuadgramsScalar(table, letters + i, size - i);
+}
+#endif
+
+// ---------- Kernel dispatch ----------
+// Every kernel produces byte-identical output to the scalar reference; the best one supported by
+// the CPU is picked on first use, and --kernel overrides the choice for benchmarking.
+struct DecryptKernel {
+    const char *name;
+    const char *description;
+    bool (*isSupported)();
+    void (*decryptBlocks)(const char *cleanLetters, size_t blockCount, const Matrix3x3 &inverseKeyMatrix, char *out);
+    size_t (*compactLetters)(const char *data, size_t size, char *out);
+    int64_t (*scoreQuadgrams)(const int16_t *table, const uint8_t *letters, size_t size);
+};
+
+bool alwaysSupported() { return true; }
+
+const vector<DecryptKernel> &decryptKernels() {
+    static const vector<DecryptKernel> kernels = {
+        {"scalar", "portable reference loop", alwaysSupported,
+         decryptBlocksScalar, compactLettersUpperScalar, scoreQuadgramsScalar},
+#ifdef HILL_HAVE_X86_KERNELS
+        {"sse4.1", "16 blocks per iteration, 8 x 16-bit lanes", cpuSupportsSse41,
+         decryptBlocksSse41, compactLettersUpperSse41, scoreQuadgramsScalar},
+        {"avx2", "32 blocks per iteration, 16 x 16-bit lanes", cpuSupportsAvx2,
+         decryptBlocksAvx2, compactLettersUpperAvx2, scoreQuadgramsAvx2},
+        {"avx512bw", "32 blocks per 512-bit operation", cpuSupportsAvx512Bw,
+         decryptBlocksAvx512Bw, compactLettersUpperAvx512Bw, scoreQuadgramsAvx2},
+        {"vbmi", "64 blocks per iteration with vpermb de-interleave; vpcompressb with VBMI2", cpuSupportsAvx512Vbmi,
+         decryptBlocksVbmi, compactLettersUpperAvx512Vbmi, scoreQuadgramsAvx2},
+#endif
+    };
+    return kernels;
+}
+
+const DecryptKernel *&activeKernelSlot() {
+    static const DecryptKernel *active = nullptr;
+    return active;
+}
+
+const DecryptKernel &activeDecryptKernel() {
+    const DecryptKernel *&active = activeKernelSlot();
+    if (!active) {
+        for (const DecryptKernel &kernel : decryptKernels())
+            if (kernel.isSupported()) active = &kernel;   // kernels are listed slowest to fastest
+    }
+    return *active;
+}
+
+void selectDecryptKernel(const string &name) {
+    for (const DecryptKernel &kernel : decryptKernels()) {
+        if (name != kernel.name) continue;
+        if (!kernel.isSupported()) throw runtime_error("Kernel '" + name + "' is not supported by this CPU.");
+        activeKernelSlot() = &kernel;
+        return;
+    }
+    throw runtime_error("Unknown kernel '" + name + "' (see --list-kernels).");
+}
+
+void listDecryptKernels(ostream &os) {
+    const DecryptKernel &active = activeDecryptKernel();
+    for (const DecryptKernel &kernel : decryptKernels()) {
+        os << (&kernel == &active ? "* " : "  ") << left << setw(10) << kernel.name
+           << (kernel.isSupported() ? "supported    " : "unsupported  ") << kernel.description << "\n";
+    }
+}
+
+// Write the alphabetic characters of data[0..size) to out (room for size bytes), uppercased;
+// returns how many were written
+size_t compactLettersUpper(const char *data, size_t size, char *out) {
+    return activeDecryptKernel().compactLetters(data, size, out);
+}
+
+// Append the alphabetic characters of data[0..size) to out, uppercased
+void appendLettersUpper(const char *data, size_t size, string &out) {
+    size_t oldSize = out.size();
+    out.resize(oldSize + size);
+    out.resize(oldSize + compactLettersUpper(data, size, &out[oldSize]));
+}
+
+string keepLettersUpper(const string &s) {
+    string out;
+    out.reserve(s.size());
+    appendLettersUpper(s.data(), s.size(), out);
+    return out;
+}
+
+// Decrypt blockCount complete 3-letter blocks of cleaned (A-Z) ciphertext into out (3 * blockCount chars)
+void decryptBlocksToBuffer(const char *cleanLetters, size_t blockCount, const Matrix3x3 &inverseKeyMatrix, char *out) {
+    activeDecryptKernel().decryptBlocks(cleanLetters, blockCount, inverseKeyMatrix, out);
+}
+
+// ---------- Batch key inversion ----------
+// Inverts large key lists without exceptions. Keys are processed 16 at a time in structure-of-arrays
+// form (one 32-bit lane per key, 16 keys per AVX-512 operation): the mod-2 inverse is the adjugate's
+// parity (the determinant must be odd), the mod-13 inverse scales the adjugate mod 13 by the
+// determinant's inverse from a 13-entry table, and the two are combined with the CRT formula of
+// combineResiduesMod26. Entries are expected in 0..25; other keys take the scalar path.
+const int KEY_BATCH_LANES = 16;
+static_assert(sizeof(Matrix3x3) == 9 * sizeof(int), "Matrix3x3 must be 9 contiguous ints");
+
+// Non-throwing single-key inversion through the same CRT steps as invertKeyMatrixMod26UsingCrt
+bool tryInvertKeyMatrixMod26(const Matrix3x3 &keyMatrix, Matrix3x3 &inverse) {
+    int det = determinant3x3(keyMatrix);
+    int detInverseMod2  = modularInverse(positiveMod(det, MOD_2), MOD_2);
+    int detInverseMod13 = modularInverse(positiveMod(det, MOD_13), MOD_13);
+    if (detInverseMod2 == -1 || detInverseMod13 == -1) return false;
+
+    Matrix3x3 adj = adjugate3x3(keyMatrix);
+    Matrix3x3 inverseMod2  = scalarMultiplyMatrixMod(matrixMod(adj, MOD_2), detInverseMod2, MOD_2);
+    Matrix3x3 inverseMod13 = scalarMultiplyMatrixMod(matrixMod(adj, MOD_13), detInverseMod13, MOD_13);
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+            inverse[r][c] = combineResiduesMod26(inverseMod2[r][c], inverseMod13[r][c]);
+    return true;
+}
+
+// Inverses of 0..12 modulo 13 (0 has none)
+const int INVERSE_MOD_13[13] = {0, 1, 7, 9, 10, 8, 11, 2, 5, 3, 4, 6, 12};
+
+// x mod 13 for 0 <= x < 6553: (x * 5042) >> 16 is floor(x / 13) on that range
+inline int reduceMod13(int x) { return x - MOD_13 * ((x * 5042) >> 16); }
+inline int reduceMod26(int x) { return x - MOD_26 * ((x * MOD_26_RECIPROCAL_16) >> 16); }
+
+// Portable structure-of-arrays version of the 16-lane kernel; returns the invertible-lane mask
+uint32_t invertKeyLanesPortable(const Matrix3x3 *keys, Matrix3x3 *inverses) {
+    int e2[9][KEY_BATCH_LANES], e13[9][KEY_BATCH_LANES];   // entries mod 2 and mod 13, one row per entry
+    uint32_t outOfRange = 0;
+    for (int e = 0; e < 9; ++e)
+        for (int l = 0; l < KEY_BATCH_LANES; ++l) {
+            int v = keys[l][e / 3][e % 3];
+            bool entryOutOfRange = v < 0 || v >= MOD_26;
+            outOfRange |= (uint32_t)entryOutOfRange << l;
+            if (entryOutOfRange) v = 0;     // keeps the lane in reduceMod13's range; the scalar pass redoes it
+            e2[e][l] = v & 1;
+            e13[e][l] = v >= MOD_13 ? v - MOD_13 : v;
+        }
+
+    // cofactor C[r][c] built from the 2x2 minor that skips row r and column c
+    static const int MINOR[9][4] = {
+        {4, 8, 5, 7}, {5, 6, 3, 8}, {3, 7, 4, 6},
+        {2, 7, 1, 8}, {0, 8, 2, 6}, {1, 6, 0, 7},
+        {1, 5, 2, 4}, {2, 3, 0, 5}, {0, 4, 1, 3}};
+    int cof2[9][KEY_BATCH_LANES], cof13[9][KEY_BATCH_LANES];
+    for (int k = 0; k < 9; ++k) {
+        const int *m = MINOR[k];
+        for (int l = 0; l < KEY_BATCH_LANES; ++l) {
+            cof2[k][l] = (e2[m[0]][l] & e2[m[1]][l]) ^ (e2[m[2]][l] & e2[m[3]][l]);
+            cof13[k][l] = reduceMod13(e13[m[0]][l] * e13[m[1]][l] - e13[m[2]][l] * e13[m[3]][l] + 169);
+        }
+    }
+
+    uint32_t invertibleMask = 0;
+    for (int l = 0; l < KEY_BATCH_LANES; ++l) {
+        int det2 = (e2[0][l] & cof2[0][l]) ^ (e2[1][l] & cof2[1][l]) ^ (e2[2][l] & cof2[2][l]);
+        int det13 = reduceMod13(e13[0][l] * cof13[0][l] + e13[1][l] * cof13[1][l] + e13[2][l] * cof13[2][l]);
+        bool invertible = det2 == 1 && det13 != 0;
+        int detInverse13 = INVERSE_MOD_13[det13];
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c) {
+                // inverse = adjugate / det, and adjugate[r][c] is cofactor[c][r]
+                int residue13 = reduceMod13(detInverse13 * cof13[3 * c + r][l]);
+                int combined = reduceMod26(13 * cof2[3 * c + r][l] + 14 * residue13);
+                inverses[l][r][c] = invertible ? combined : 0;
+            }
+        invertibleMask |= (uint32_t)invertible << l;
+    }
+
+    for (int l = 0; l < KEY_BATCH_LANES; ++l) {
+        if (!(outOfRange >> l & 1)) continue;
+        Matrix3x3 inverse{};
+        bool invertible = tryInvertKeyMatrixMod26(keys[l], inverse);
+        inverses[l] = inverse;
+        invertibleMask = (invertibleMask & ~(1u << l)) | ((uint32_t)invertible << l);
+    }
+    return invertibleMask;
+}
+
+#ifdef HILL_HAVE_X86_KERNELS
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i reduceMod13Avx512(__m512i x) {
+    __m512i quotient = _mm512_srli_epi32(_mm512_mullo_epi32(x, _mm512_set1_epi32(5042)), 16);
+    return _mm512_sub_epi32(x, _mm512_mullo_epi32(quotient, _mm512_set1_epi32(MOD_13)));
+}
+
+// 16 keys per operation: gather 9 SoA entry vectors, then every step runs on all 16 keys at once
+__attribute__((target("avx512f,avx512bw")))
+uint32_t invertKeyLanesAvx512(const Matrix3x3 *keys, Matrix3x3 *inverses) {
+    const int *base = &keys[0][0][0];
+    const __m512i laneOffsets = _mm512_mullo_epi32(_mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0),
+                                                   _mm512_set1_epi32(9));
+    const __m512i one = _mm512_set1_epi32(1), thirteen = _mm512_set1_epi32(MOD_13);
+
+    __m512i e2[9], e13[9];
+    __mmask16 outOfRange = 0;
+    for (int e = 0; e < 9; ++e) {
+        __m512i v = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF,
+                                                _mm512_add_epi32(laneOffsets, _mm512_set1_epi32(e)), base, 4);
+        outOfRange |= _mm512_cmpgt_epu32_mask(v, _mm512_set1_epi32(MOD_26 - 1));
+        e2[e] = _mm512_and_si512(v, one);
+        e13[e] = _mm512_mask_sub_epi32(v, _mm512_cmpge_epu32_mask(v, thirteen), v, thirteen);
+    }
+    if (outOfRange) return invertKeyLanesPortable(keys, inverses);
+
+    static const int MINOR[9][4] = {
+        {4, 8, 5, 7}, {5, 6, 3, 8}, {3, 7, 4, 6},
+        {2, 7, 1, 8}, {0, 8, 2, 6}, {1, 6, 0, 7},
+        {1, 5, 2, 4}, {2, 3, 0, 5}, {0, 4, 1, 3}};
+    __m512i cof2[9], cof13[9];
+    const __m512i bias = _mm512_set1_epi32(169);
+    for (int k = 0; k < 9; ++k) {
+        const int *m = MINOR[k];
+        cof2[k] = _mm512_xor_si512(_mm512_and_si512(e2[m[0]], e2[m[1]]), _mm512_and_si512(e2[m[2]], e2[m[3]]));
+        cof13[k] = reduceMod13Avx512(_mm512_add_epi32(_mm512_sub_epi32(_mm512_mullo_epi32(e13[m[0]], e13[m[1]]),
+                                                                       _mm512_mullo_epi32(e13[m[2]], e13[m[3]])), bias));
+    }
+
+    __m512i det2 = _mm512_xor_si512(_mm512_xor_si512(_mm512_and_si512(e2[0], cof2[0]), _mm512_and_si512(e2[1], cof2[1])),
+                                    _mm512_and_si512(e2[2], cof2[2]));
+    __m512i det13 = reduceMod13Avx512(_mm512_add_epi32(_mm512_add_epi32(_mm512_mullo_epi32(e13[0], cof13[0]),
+                                                                        _mm512_mullo_epi32(e13[1], cof13[1])),
+                                                       _mm512_mullo_epi32(e13[2], cof13[2])));
+    __mmask16 invertible = _mm512_cmpeq_epi32_mask(det2, one) & _mm512_cmpneq_epi32_mask(det13, _mm512_setzero_si512());
+    const __m512i inverseTable = _mm512_setr_epi32(0, 1, 7, 9, 10, 8, 11, 2, 5, 3, 4, 6, 12, 0, 0, 0);
+    __m512i detInverse13 = _mm512_permutexvar_epi32(det13, inverseTable);
+
+    int *outBase = &inverses[0][0][0];
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c) {
+            __m512i residue13 = reduceMod13Avx512(_mm512_mullo_epi32(detInverse13, cof13[3 * c + r]));
+            __m512i sum = _mm512_add_epi32(_mm512_mullo_epi32(cof2[3 * c + r], thirteen),
+                                           _mm512_mullo_epi32(residue13, _mm512_set1_epi32(14)));
+            __m512i quotient = _mm512_srli_epi32(_mm512_mullo_epi32(sum, _mm512_set1_epi32(MOD_26_RECIPROCAL_16)), 16);
+            __m512i combined = _mm512_maskz_sub_epi32(invertible, sum, _mm512_mullo_epi32(quotient, _mm512_set1_epi32(MOD_26)));
+            _mm512_i32scatter_epi32(outBase, _mm512_add_epi32(laneOffsets, _mm512_set1_epi32(3 * r + c)), combined, 4);
+        }
+    return invertible;
+}
+#endif
+
+// Invert keys[0..count) into inverses[0..count) without throwing. statusBits must hold
+// (count + 63) / 64 words; bit i is set when key i is invertible mod 26, otherwise inverses[i]
+// is the zero matrix. Returns the number of invertible keys.
+size_t invertKeyMatricesBatch(const Matrix3x3 *keys, size_t count, Matrix3x3 *inverses, uint64_t *statusBits) {
+    fill(statusBits, statusBits + (count + 63) / 64, 0);
+    bool useAvx512 = false;
+#ifdef HILL_HAVE_X86_KERNELS
+    useAvx512 = cpuSupportsAvx512Bw();
+#endif
+    size_t invertibleCount = 0;
+    size_t i = 0;
+    for (; i + KEY_BATCH_LANES <= count; i += KEY_BATCH_LANES) {
+        uint32_t mask;
+#ifdef HILL_HAVE_X86_KERNELS
+        if (useAvx512) mask = invertKeyLanesAvx512(keys + i, inverses + i);
+        else
+#endif
+        mask = invertKeyLanesPortable(keys + i, inverses + i);
+        statusBits[i / 64] |= (uint64_t)mask << (i % 64);
+        invertibleCount += bitset<KEY_BATCH_LANES>(mask).count();
+    }
+    for (; i < count; ++i) {
+        Matrix3x3 inverse{};
+        if (tryInvertKeyMatrixMod26(keys[i], inverse)) {
+            statusBits[i / 64] |= 1ULL << (i % 64);
+            ++invertibleCount;
+        }
+        inverses[i] = inverse;
+    }
+    return invertibleCount;
+}
+
+// ---------- Trigram decode table ----------
+// With only 26^3 possible ciphertext blocks, the inverse key is fully described by a table mapping
+// the trigram code c0*676 + c1*26 + c2 to the 3 plaintext letters (17,576 * 3 bytes = ~51 KB).
+const int TRIGRAM_COUNT = MOD_26 * MOD_26 * MOD_26;
+// Building the table costs about as much as decrypting a few thousand blocks with the scalar kernel
+const size_t TRIGRAM_TABLE_MIN_BLOCKS = 8192;
+const size_t TRIGRAM_PREFETCH_DISTANCE = 8;
+
+enum class DecodeEngine { Auto, Kernel, TrigramTable, Fused };
+
+DecodeEngine parseDecodeEngine(const string &name) {
+    if (name == "auto") return DecodeEngine::Auto;
+    if (name == "kernel") return DecodeEngine::Kernel;
+    if (name == "table") return DecodeEngine::TrigramTable;
+    if (name == "fused") return DecodeEngine::Fused;
+    throw runtime_error("Unknown engine '" + name + "' (expected auto, kernel, table or fused).");
+}
+
+vector<char> buildTrigramDecodeTable(const Matrix3x3 &inverseKeyMatrix) {
+    Matrix3x3 k = matrixMod(inverseKeyMatrix, MOD_26);
+    vector<char> table(3 * TRIGRAM_COUNT);
+    char *entry = table.data();
+    for (int c0 = 0; c0 < MOD_26; ++c0)
+        for (int c1 = 0; c1 < MOD_26; ++c1) {
+            int partial[3];
+            for (int r = 0; r < 3; ++r) partial[r] = k[r][0] * c0 + k[r][1] * c1;
+            for (int c2 = 0; c2 < MOD_26; ++c2, entry += 3)
+                for (int r = 0; r < 3; ++r) entry[r] = ALPHABET[(partial[r] + k[r][2] * c2) % MOD_26];
+        }
+    return table;
+}
+
+inline int trigramCode(const char *block) {
+    return (block[0] - 'A') * (MOD_26 * MOD_26) + (block[1] - 'A') * MOD_26 + (block[2] - 'A');
+}
+
+// One table load per block; entries for a few blocks ahead are prefetched
+void decryptBlocksWithTrigramTable(const char *cleanLetters, size_t blockCount, const vector<char> &table, char *out) {
+    const char *entries = table.data();
+    for (size_t b = 0; b < blockCount; ++b) {
+#ifdef __GNUC__
+        if (b + TRIGRAM_PREFETCH_DISTANCE < blockCount)
+            __builtin_prefetch(entries + 3 * trigramCode(cleanLetters + 3 * (b + TRIGRAM_PREFETCH_DISTANCE)));
+#endif
+        memcpy(out + 3 * b, entries + 3 * trigramCode(cleanLetters + 3 * b), 3);
+    }
+}
+
+// ---------- Prepared inverse key ----------
+// Inverse key plus the optional trigram decode table, prepared once per key and input
+struct PreparedInverseKey {
+    Matrix3x3 inverse;
+    vector<char> trigramTable;  // empty when the block kernels are used
+    bool fusedPipeline = false; // single-threaded paths decrypt straight from raw input bytes
+};
+
+// Auto keeps the compact-then-decrypt vector kernel when one is available, since every vector
+// kernel outruns the table; otherwise it uses the fused pipeline and builds the table when the
+// input is large enough to pay for it. The table is therefore a fallback for pre-SSE4.1 CPUs.
+// expectedBlocks may be SIZE_MAX for streams of unknown length.
+PreparedInverseKey prepareInverseKey(const Matrix3x3 &inverseKeyMatrix, size_t expectedBlocks,
+                                     DecodeEngine engine = DecodeEngine::Auto) {
+    PreparedInverseKey prepared;
+    prepared.inverse = matrixMod(inverseKeyMatrix, MOD_26);
+    bool buildTable = engine == DecodeEngine::TrigramTable;
+    prepared.fusedPipeline = engine == DecodeEngine::Fused;
+    if (engine == DecodeEngine::Auto) {
+        bool vectorKernel = activeDecryptKernel().decryptBlocks != decryptBlocksScalar;
+        prepared.fusedPipeline = !vectorKernel;
+        buildTable = !vectorKernel && expectedBlocks >= TRIGRAM_TABLE_MIN_BLOCKS;
+    }
+    if (buildTable) prepared.trigramTable = buildTrigramDecodeTable(inverseKeyMatrix);
+    return prepared;
+}
+
+void decryptBlocksToBuffer(const char *cleanLetters, size_t blockCount, const PreparedInverseKey &key, char *out) {
+    if (!key.trigramTable.empty()) decryptBlocksWithTrigramTable(cleanLetters, blockCount, key.trigramTable, out);
+    else decryptBlocksToBuffer(cleanLetters, blockCount, key.inverse, out);
+}
+
+// ---------- Fused filter/decrypt pipeline ----------
+// Single pass from raw input bytes to plaintext: each byte is classified through LETTER_INDEX_TABLE,
+// letter indices accumulate in a 3-slot block register, and a block is decrypted (one table load,
+// or the 3x3 product) and emitted as soon as it fills. No cleaned intermediate buffer is built.
+struct FusedBlockRegister {
+    int slots[3] = {0, 0, 0};
+    int filled = 0;
+};
+
+inline void decryptRegisterBlock(const int (&x)[3], const PreparedInverseKey &key, char *out) {
+    if (!key.trigramTable.empty()) {
+        memcpy(out, key.trigramTable.data() + 3 * (x[0] * (MOD_26 * MOD_26) + x[1] * MOD_26 + x[2]), 3);
+        return;
+    }
+    const Matrix3x3 &k = key.inverse;
+    for (int r = 0; r < 3; ++r)
+        out[r] = (char)('A' + (k[r][0] * x[0] + k[r][1] * x[1] + k[r][2] * x[2]) % MOD_26);
+}
+
+// Returns the number of plaintext letters written to out (at most size + 2 with a carried register)
+size_t fusedDecryptWindow(const char *data, size_t size, const PreparedInverseKey &key,
+                          FusedBlockRegister &reg, char *out) {
+    size_t written = 0;
+    for (size_t k = 0; k < size; ++k) {
+        uint8_t index = LETTER_INDEX_TABLE[data[k]];
+        if (index == NOT_A_LETTER) continue;
+        reg.slots[reg.filled++] = index;
+        if (reg.filled == 3) {
+            decryptRegisterBlock(reg.slots, key, out + written);
+            written += 3;
+            reg.filled = 0;
+        }
+    }
+    return written;
+}
+
+// Pad a partially filled register with 'X' at end of input; returns letters written (0 or 3)
+size_t fusedFinish(FusedBlockRegister &reg, const PreparedInverseKey &key, char *out) {
+    if (reg.filled == 0) return 0;
+    while (reg.filled < 3) reg.slots[reg.filled++] = 'X' - 'A';
+    decryptRegisterBlock(reg.slots, key, out);
+    reg.filled = 0;
+    return 3;
+}
+
 // ---------- Decryption ----------
-string decryptCiphertextWithKeyInverse(const string &ciphertextInput, const Matrix3x3 &inverseKeyMatrix) {
+// Same as decryptBlocksToBuffer, appending the plaintext to out
+void appendDecryptedBlocks(const char *cleanLetters, size_t blockCount, const PreparedInverseKey &key, string &out) {
+    size_t oldSize = out.size();
+    out.resize(oldSize + 3 * blockCount);
+    decryptBlocksToBuffer(cleanLetters, blockCount, key, &out[oldSize]);
+}
+
+string decryptCiphertextWithKeyInverse(const string &ciphertextInput, const PreparedInverseKey &key) {
+    if (key.fusedPipeline) {
+        FusedBlockRegister reg;
+        string plaintext(ciphertextInput.size() + 2, '\0');
+        size_t written = fusedDecryptWindow(ciphertextInput.data(), ciphertextInput.size(), key, reg, &plaintext[0]);
+        written += fusedFinish(reg, key, &plaintext[written]);
+        plaintext.resize(written);
+        return plaintext;
+    }
+
     string cleanCipher = keepLettersUpper(ciphertextInput);
     // pad with 'X' to make length multiple of 3
     int paddingNeeded = (3 - (int)cleanCipher.size() % 3) % 3;
@@ -184,44 +1091,3549 @@ string decryptCiphertextWithKeyInverse(const string &ciphertextInput, const Matr
 
     string plaintext;
     plaintext.reserve(cleanCipher.size());
-    for (size_t i = 0; i < cleanCipher.size(); i += 3) {
-        array<int,3> blockVector;
-        for (int j = 0; j < 3; ++j) blockVector[j] = letterIndex(cleanCipher[i + j]);
-        array<int,3> plainVector = multiplyMatrixVectorMod(inverseKeyMatrix, blockVector, MOD_26);
-        for (int j = 0; j < 3; ++j) plaintext.push_back(ALPHABET[ plainVector[j] ]);
-    }
+    appendDecryptedBlocks(cleanCipher.data(), cleanCipher.size() / 3, key, plaintext);
     return plaintext;
 }
 
-// ---------- Main interactive routine ----------
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
+string decryptCiphertextWithKeyInverse(const string &ciphertextInput, const Matrix3x3 &inverseKeyMatrix) {
+    // every input byte may be a letter, so the input length bounds the block count
+    return decryptCiphertextWithKeyInverse(ciphertextInput,
+                                           prepareInverseKey(inverseKeyMatrix, ciphertextInput.size() / 3));
+}
 
-    try {
-        cout << "Enter 9-letter key (row-major, A-Z): ";
-        string keyInput;
-        if (!getline(cin, keyInput)) {
-            cerr << "No key input provided.\n";
-            return 1;
+// ---------- Thread pool ----------
+// Fixed set of worker threads; parallelFor hands out task indices to the workers and the calling thread
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount) {
+        for (unsigned t = 1; t < max(1u, threadCount); ++t) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(poolMutex);
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+        for (thread &worker : workers) worker.join();
+    }
+
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    // Run task(i) for every i in [0, taskCount); returns once all tasks have finished
+    void parallelFor(size_t taskCount, const function<void(size_t)> &task) {
+        if (taskCount == 0) return;
+        if (workers.empty() || taskCount == 1) {
+            for (size_t i = 0; i < taskCount; ++i) task(i);
+            return;
+        }
+        {
+            lock_guard<mutex> lock(poolMutex);
+            currentTask = &task;
+            taskTotal = taskCount;
+            nextTask = 0;
+            busyWorkers = workers.size();
+            ++generation;
+        }
+        wakeWorkers.notify_all();
+        runTasks();
+        unique_lock<mutex> lock(poolMutex);
+        workersDone.wait(lock, [this] { return busyWorkers == 0; });
+        currentTask = nullptr;
+    }
+
+private:
+    void runTasks() {
+        for (;;) {
+            size_t i = nextTask.fetch_add(1);
+            if (i >= taskTotal) break;
+            (*currentTask)(i);
+        }
+    }
+
+    void workerLoop() {
+        size_t seenGeneration = 0;
+        for (;;) {
+            {
+                unique_lock<mutex> lock(poolMutex);
+                wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) return;
+                seenGeneration = generation;
+            }
+            runTasks();
+            lock_guard<mutex> lock(poolMutex);
+            if (--busyWorkers == 0) workersDone.notify_one();
+        }
+    }
+
+    vector<thread> workers;
+    mutex poolMutex;
+    condition_variable wakeWorkers, workersDone;
+    const function<void(size_t)> *currentTask = nullptr;
+    size_t taskTotal = 0;
+    atomic<size_t> nextTask{0};
+    size_t busyWorkers = 0;
+    size_t generation = 0;
+    bool stopping = false;
+};
+
+unsigned resolveThreadCount(unsigned requested) {
+    if (requested != 0) return requested;
+    return max(1u, thread::hardware_concurrency());
+}
+
+// ---------- Inverse-key cache ----------
+// Bounded, thread-safe cache from the normalized 9-letter key to its prepared inverse (inverse
+// matrix plus decode table), so repeated-key workloads skip determinant, adjugate, modular
+// inverses and CRT entirely. Keys are spread over independently locked shards; each shard keeps
+// an LRU list and evicts from its tail once its share of the memory budget is exceeded.
+const size_t DEFAULT_KEY_CACHE_BYTES = 64 << 20;
+
+struct KeyCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+class InverseKeyCache {
+public:
+    explicit InverseKeyCache(size_t memoryBudget = DEFAULT_KEY_CACHE_BYTES, DecodeEngine engine = DecodeEngine::Auto)
+        : engine(engine), shardBudget(max<size_t>(1, memoryBudget / SHARD_COUNT)) {}
+
+    // Returns the prepared inverse for keyString; throws like invertKeyMatrixMod26UsingCrt for bad keys
+    shared_ptr<const PreparedInverseKey> get(const string &keyString) {
+        string normalized = keepLettersUpper(keyString);
+        Shard &shard = shards[hash<string>()(normalized) % SHARD_COUNT];
+        {
+            lock_guard<mutex> lock(shard.shardMutex);
+            auto found = shard.index.find(normalized);
+            if (found != shard.index.end()) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+                hits.fetch_add(1, memory_order_relaxed);
+                return found->second->prepared;
+            }
         }
+        misses.fetch_add(1, memory_order_relaxed);
 
-        // Validate and build key matrix
-        Matrix3x3 keyMatrix = createKeyMatrixFromString(keyInput);
+        // build outside the lock; a racing thread may build the same key, the first insert wins
+        Matrix3x3 inverse = invertKeyMatrixMod26UsingCrt(createKeyMatrixFromString(normalized));
+        auto prepared = make_shared<const PreparedInverseKey>(prepareInverseKey(inverse, SIZE_MAX, engine));
+        size_t cost = entryCost(normalized, *prepared);
+
+        lock_guard<mutex> lock(shard.shardMutex);
+        auto found = shard.index.find(normalized);
+        if (found != shard.index.end()) return found->second->prepared;
+        shard.lru.push_front(Entry{normalized, prepared, cost});
+        shard.index.emplace(normalized, shard.lru.begin());
+        shard.bytes += cost;
+        while (shard.bytes > shardBudget && shard.lru.size() > 1) {
+            Entry &victim = shard.lru.back();
+            shard.bytes -= victim.cost;
+            shard.index.erase(victim.key);
+            shard.lru.pop_back();
+            evictions.fetch_add(1, memory_order_relaxed);
+        }
+        return prepared;
+    }
 
-        cout << "Enter ciphertext (any text; non-letters ignored): ";
-        string ciphertextInput;
-        if (!getline(cin, ciphertextInput)) {
-            cerr << "No ciphertext input provided.\n";
-            return 1;
+    KeyCacheStats stats() {
+        KeyCacheStats result;
+        result.hits = hits.load();
+        result.misses = misses.load();
+        result.evictions = evictions.load();
+        for (Shard &shard : shards) {
+            lock_guard<mutex> lock(shard.shardMutex);
+            result.entries += shard.lru.size();
+            result.bytes += shard.bytes;
         }
+        return result;
+    }
+
+private:
+    static const size_t SHARD_COUNT = 16;
+
+    struct Entry {
+        string key;
+        shared_ptr<const PreparedInverseKey> prepared;
+        size_t cost;
+    };
+
+    struct Shard {
+        mutex shardMutex;
+        list<Entry> lru;    // most recently used first
+        unordered_map<string, list<Entry>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    static size_t entryCost(const string &key, const PreparedInverseKey &prepared) {
+        const size_t bookkeeping = 128;     // list node, hash node, control block
+        return sizeof(Entry) + key.capacity() + sizeof(PreparedInverseKey) + prepared.trigramTable.capacity()
+               + bookkeeping;
+    }
+
+    DecodeEngine engine;
+    size_t shardBudget;
+    Shard shards[SHARD_COUNT];
+    atomic<uint64_t> hits{0}, misses{0}, evictions{0};
+};
 
-        // Compute inverse key matrix modulo 26 using CRT
-        Matrix3x3 inverseKey = invertKeyMatrixMod26UsingCrt(keyMatrix);
+// ---------- Chunk-parallel window decryption ----------
+// Smallest input slice worth handing to its own thread
+const size_t MIN_PARALLEL_PARTITION_BYTES = 1 << 16;
 
-        // Decrypt and print result
-        string plaintext = decryptCiphertextWithKeyInverse(ciphertextInput, inverseKey);
-        cout << "Decrypted plaintext (uppercase): " << plaintext << "\n";
+// Decrypts consecutive windows of raw input, carrying an incomplete block from one window to the
+// next. With more than one thread, each partition is compacted into its own scratch buffer, since
+// the compaction kernels may write past the letters they return. An exclusive scan of the letter
+// counts gives each partition its offset, and the partitions are copied there in parallel. The
+// cleaned blocks are then split on block-aligned boundaries, so each thread writes its plaintext
+// directly at its final position.
+class WindowDecryptor {
+public:
+    WindowDecryptor(const PreparedInverseKey &key, ThreadPool &pool) : key(key), pool(pool) {}
+
+    // Decrypt the complete blocks available after this window into out, which must have room for
+    // size + 2 letters. Returns the number of plaintext letters written.
+    size_t decryptWindow(const char *data, size_t size, char *out) {
+        size_t partitions = min<size_t>(pool.size(), max<size_t>(1, size / MIN_PARALLEL_PARTITION_BYTES));
+        size_t partitionSize = (size + partitions - 1) / max<size_t>(1, partitions);
+        size_t carried = carryLength;
+        size_t letterCount;
+
+        if (partitions <= 1 && key.fusedPipeline) {
+            FusedBlockRegister reg;
+            for (size_t j = 0; j < carried; ++j) reg.slots[reg.filled++] = carry[j] - 'A';
+            size_t written = fusedDecryptWindow(data, size, key, reg, out);
+            carryLength = (size_t)reg.filled;
+            for (size_t j = 0; j < carryLength; ++j) carry[j] = (char)('A' + reg.slots[j]);
+            return written;
+        }
+
+        letters.resize(carried + size);
+        memcpy(letters.data(), carry, carried);
+        if (partitions <= 1) {
+            letterCount = carried + compactLettersUpper(data, size, letters.data() + carried);
+        } else {
+            vector<size_t> offsets(partitions + 1, 0);
+            partitionLetters.resize(partitions);
+            pool.parallelFor(partitions, [&](size_t p) {
+                size_t begin = p * partitionSize, end = min(size, begin + partitionSize);
+                partitionLetters[p].resize(partitionSize);
+                if (begin < end) offsets[p + 1] = compactLettersUpper(data + begin, end - begin, partitionLetters[p].data());
+            });
+            offsets[0] = carried;
+            for (size_t p = 0; p < partitions; ++p) offsets[p + 1] += offsets[p];
+            pool.parallelFor(partitions, [&](size_t p) {
+                memcpy(letters.data() + offsets[p], partitionLetters[p].data(), offsets[p + 1] - offsets[p]);
+            });
+            letterCount = offsets[partitions];
+        }
+
+        size_t blockCount = letterCount / 3;
+        size_t blockPartitions = min<size_t>(partitions, max<size_t>(1, blockCount));
+        size_t blocksPerPartition = (blockCount + blockPartitions - 1) / blockPartitions;
+        pool.parallelFor(blockPartitions, [&](size_t p) {
+            size_t begin = p * blocksPerPartition, end = min(blockCount, begin + blocksPerPartition);
+            if (begin < end)
+                decryptBlocksToBuffer(letters.data() + 3 * begin, end - begin, key, out + 3 * begin);
+        });
+
+        carryLength = letterCount - 3 * blockCount;
+        memcpy(carry, letters.data() + 3 * blockCount, carryLength);
+        return 3 * blockCount;
+    }
+
+    // At end of input, pad the carried partial block with 'X' and decrypt it into out (room for 3 letters)
+    size_t finish(char *out) {
+        if (carryLength == 0) return 0;
+        for (size_t j = carryLength; j < 3; ++j) carry[j] = 'X';
+        carryLength = 0;
+        decryptBlocksToBuffer(carry, 1, key, out);
+        return 3;
+    }
+
+private:
+    const PreparedInverseKey &key;
+    ThreadPool &pool;
+    vector<char> letters;
+    vector<vector<char>> partitionLetters;     // per-partition compaction scratch
+    char carry[3] = {0, 0, 0};
+    size_t carryLength = 0;
+};
+
+// ---------- Streaming decryption ----------
+const size_t DEFAULT_STREAM_CHUNK_SIZE = 1 << 20;
+
+// Decrypt everything readable from `in` to `out` using O(chunkSize) memory.
+// Input is read in fixed-size chunks; an incomplete block (at most 2 letters) is carried
+// over to the next chunk, and 'X' padding is only applied once the stream is exhausted.
+// Returns the number of plaintext letters written.
+size_t streamDecryptCiphertext(istream &in, ostream &out, const PreparedInverseKey &key,
+                               size_t chunkSize = DEFAULT_STREAM_CHUNK_SIZE, unsigned threadCount = 1) {
+    if (chunkSize == 0) throw runtime_error("Stream chunk size must be positive.");
+    ThreadPool pool(threadCount);
+    WindowDecryptor decryptor(key, pool);
+    vector<char> chunk(chunkSize);
+    vector<char> plaintext(chunkSize + 3);
+    size_t written = 0;
+
+    while (in) {
+        in.read(chunk.data(), (streamsize)chunk.size());
+        size_t got = (size_t)in.gcount();
+        if (got == 0) break;
+
+        size_t produced = decryptor.decryptWindow(chunk.data(), got, plaintext.data());
+        out.write(plaintext.data(), (streamsize)produced);
+        written += produced;
+    }
+
+    size_t produced = decryptor.finish(plaintext.data());
+    out.write(plaintext.data(), (streamsize)produced);
+    written += produced;
+    out.flush();
+    if (!out) throw runtime_error("Failed to write plaintext output.");
+    return written;
+}
+
+// ---------- Alphabets and moduli ----------
+// Hill traffic over other alphabets works mod the alphabet size m. ModulusContext factors m once
+// into prime powers p^k and keeps, per factor, a table of inverses mod p and the CRT coefficient
+// e (e = 1 mod p^k, 0 mod the other factors), so x mod m = sum of residue * e. Keys are inverted
+// mod p and Hensel-lifted to p^k when k > 1 (HillEngine::liftInverse). Reduction mod m uses Barrett
+// constants: q = (x * multiplier) >> shift is floor(x / m) or one less for every x up to the
+// bound the context was built for, so x - q * m needs at most one subtraction of m.
+struct ModulusContext {
+    int modulus = 0;
+    vector<int> primes;
+    vector<int> primePowers;                    // p^k dividing modulus exactly, in primes order
+    vector<int> crtCoefficients;                // one per prime power
+    vector<vector<uint16_t>> inverseTables;     // [prime index][a] = a^-1 mod prime (0 for a = 0)
+    uint32_t reductionBound = 0;                // largest x reduce() is exact for
+    uint32_t barrettMultiplier = 0;
+    int barrettShift = 0;
+
+    // Context for alphabet size modulus, reducing values up to reductionBound. A context only used
+    // to invert keys (moduli above 256, which no stream alphabet reaches) passes 0 and must not
+    // call reduce().
+    static ModulusContext forModulus(int modulus, uint32_t reductionBound) {
+        if (modulus < 2 || modulus > 65536) throw runtime_error("Modulus must be between 2 and 65536.");
+        ModulusContext context;
+        context.modulus = modulus;
+        int rest = modulus;
+        for (int p = 2; rest > 1; ++p) {
+            if (rest % p != 0) continue;
+            int power = 1;
+            while (rest % p == 0) rest /= p, power *= p;
+            context.primes.push_back(p);
+            context.primePowers.push_back(power);
+        }
+        for (size_t i = 0; i < context.primes.size(); ++i) {
+            int p = context.primes[i], power = context.primePowers[i], cofactor = modulus / power;
+            context.crtCoefficients.push_back((int)(1LL * cofactor * modularInverse(cofactor % power, power) % modulus));
+            // a^-1 = -(p / a) * (p mod a)^-1 mod p, so the table costs one step per entry
+            vector<uint16_t> inverses(p, 0);
+            inverses[1] = 1;
+            for (int a = 2; a < p; ++a) inverses[a] = (uint16_t)(p - 1LL * (p / a) * inverses[p % a] % p);
+            context.inverseTables.push_back(move(inverses));
+        }
+        // smallest shift covering the bound whose multiplier keeps x * multiplier within 32 bits
+        context.reductionBound = reductionBound;
+        context.barrettShift = 1;
+        while ((1ULL << context.barrettShift) <= reductionBound) ++context.barrettShift;
+        context.barrettMultiplier = (uint32_t)((1ULL << context.barrettShift) / modulus);
+        if ((uint64_t)reductionBound * context.barrettMultiplier >= (1ULL << 32))
+            throw runtime_error("Row sums are too large for 32-bit Barrett reduction.");
+        return context;
+    }
+
+    uint32_t reduce(uint32_t x) const {
+        uint32_t r = x - ((x * barrettMultiplier) >> barrettShift) * modulus;
+        return r >= (uint32_t)modulus ? r - modulus : r;
+    }
+
+    // x mod modulus from its residues mod each prime power (in primes order)
+    int combine(const int *residues) const {
+        long long x = 0;
+        for (size_t i = 0; i < primes.size(); ++i) x = (x + 1LL * residues[i] * crtCoefficients[i]) % modulus;
+        return (int)x;
+    }
+};
+
+// Symbols of an alphabet in index order; bytes outside it are dropped from ciphertext and keys
+const uint16_t NOT_A_SYMBOL = 0xFFFF;
+
+struct Alphabet {
+    string name;
+    string symbols;
+    uint16_t index[256];
+    char padding;       // completes the last block: 'X' when the alphabet has it, else its first symbol
+
+    static Alphabet fromSymbols(const string &name, const string &symbols, bool foldCase = false) {
+        Alphabet alphabet;
+        alphabet.name = name;
+        alphabet.symbols = symbols;
+        fill(begin(alphabet.index), end(alphabet.index), NOT_A_SYMBOL);
+        if (symbols.size() < 2 || symbols.size() > 256) throw runtime_error("An alphabet needs 2 to 256 symbols.");
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            uint16_t &slot = alphabet.index[(unsigned char)symbols[i]];
+            if (slot != NOT_A_SYMBOL) throw runtime_error("Alphabet repeats the symbol '" + string(1, symbols[i]) + "'.");
+            slot = (uint16_t)i;
+        }
+        if (foldCase)
+            for (int ch = 'a'; ch <= 'z'; ++ch)
+                if (alphabet.index[ch] == NOT_A_SYMBOL) alphabet.index[ch] = alphabet.index[ch - 'a' + 'A'];
+        alphabet.padding = alphabet.index['X'] != NOT_A_SYMBOL ? 'X' : symbols[0];
+        return alphabet;
+    }
+
+    // letters (26), alnum (A-Z, 0-9 and space: 37), printable (ASCII 32-126: 95), bytes (all 256),
+    // or the symbols themselves
+    static Alphabet fromName(const string &name) {
+        string digits = "0123456789", printable, bytes;
+        for (int ch = 32; ch < 127; ++ch) printable += (char)ch;
+        for (int ch = 0; ch < 256; ++ch) bytes += (char)ch;
+        if (name == "letters") return fromSymbols(name, ALPHABET, true);
+        if (name == "alnum") return fromSymbols(name, ALPHABET + digits + " ", true);
+        if (name == "printable") return fromSymbols(name, printable);
+        if (name == "bytes") return fromSymbols(name, bytes);
+        return fromSymbols("custom", name);
+    }
+
+    int size() const { return (int)symbols.size(); }
+
+    // Symbol indices of the alphabet's symbols in data[0..size), appended to out
+    void appendIndices(const char *data, size_t size, vector<uint8_t> &out) const {
+        size_t oldSize = out.size();
+        out.resize(oldSize + size);
+        uint8_t *write = out.data() + oldSize;
+        size_t count = 0;
+        for (size_t k = 0; k < size; ++k) {
+            uint16_t symbol = index[(unsigned char)data[k]];
+            write[count] = (uint8_t)symbol;     // overwritten by the next symbol when not in the alphabet
+            count += symbol != NOT_A_SYMBOL;
+        }
+        out.resize(oldSize + count);
+    }
+};
+
+// Keys over the bytes alphabet, given as hex digits (whitespace ignored)
+string hexToBytes(const string &hexDigits) {
+    string digits, bytes;
+    for (char ch : hexDigits)
+        if (!isspace((unsigned char)ch)) digits += ch;
+    if (digits.size() % 2 != 0 || digits.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+        throw runtime_error("A bytes key must be an even number of hex digits.");
+    for (size_t i = 0; i < digits.size(); i += 2) bytes += (char)stoi(digits.substr(i, 2), nullptr, 16);
+    return bytes;
+}
+
+// ---------- N x N Hill engine ----------
+// The 3x3 pipeline generalised over the block size at compile time, instantiated for N = 2..8.
+// Every loop bound is the template parameter, so matrices live in fixed-size arrays and the
+// compiler unrolls them. Inversion is Gauss-Jordan elimination in the fields mod 2 and mod 13,
+// combined element-wise with combineResiduesMod26(). Blocks are decrypted HILL_TILE_BLOCKS at a
+// time: the tile is transposed into N 16-bit columns, each plaintext row is a fixed-length
+// multiply-add over those columns, and the reduction is the kernels' 2521 reciprocal (row sums
+// are at most 8 * 25 * 25 = 5000 < 6553). On x86 the tile loop is also built for AVX2 and AVX-512BW.
+const int HILL_MIN_BLOCK_SIZE = 2;
+const int HILL_MAX_BLOCK_SIZE = 8;
+const size_t HILL_TILE_BLOCKS = 32;
+
+template <int N>
+using HillMatrix = array<array<int, N>, N>;
+
+// Decrypt one full tile of HILL_TILE_BLOCKS blocks; inlined into each target's wrapper
+template <int N>
+__attribute__((always_inline)) inline void decryptHillTile(const char *cleanLetters, const HillMatrix<N> &inverse,
+                                                           char *out) {
+    alignas(64) uint16_t column[N][HILL_TILE_BLOCKS];
+    alignas(64) uint16_t row[N][HILL_TILE_BLOCKS];
+    for (size_t b = 0; b < HILL_TILE_BLOCKS; ++b)
+        for (int j = 0; j < N; ++j) column[j][b] = (uint16_t)(cleanLetters[N * b + j] - 'A');
+    for (int r = 0; r < N; ++r) {
+        uint16_t sum[HILL_TILE_BLOCKS] = {};
+        for (int j = 0; j < N; ++j) {
+            uint16_t k = (uint16_t)inverse[r][j];
+            for (size_t b = 0; b < HILL_TILE_BLOCKS; ++b) sum[b] = (uint16_t)(sum[b] + k * column[j][b]);
+        }
+        for (size_t b = 0; b < HILL_TILE_BLOCKS; ++b)
+            row[r][b] = (uint16_t)(sum[b] - MOD_26 * ((sum[b] * 2521u) >> 16));
+    }
+    for (size_t b = 0; b < HILL_TILE_BLOCKS; ++b)
+        for (int r = 0; r < N; ++r) out[N * b + r] = (char)('A' + row[r][b]);
+}
+
+// Full tiles in place; the last partial tile goes through a padded copy
+template <int N>
+__attribute__((always_inline)) inline void decryptHillBlocks(const char *cleanLetters, size_t blockCount,
+                                                             const HillMatrix<N> &inverse, char *out) {
+    size_t b = 0;
+    for (; b + HILL_TILE_BLOCKS <= blockCount; b += HILL_TILE_BLOCKS)
+        decryptHillTile<N>(cleanLetters + N * b, inverse, out + N * b);
+    if (b == blockCount) return;
+    char tile[N * HILL_TILE_BLOCKS], plain[N * HILL_TILE_BLOCKS];
+    size_t tailLetters = N * (blockCount - b);
+    memcpy(tile, cleanLetters + N * b, tailLetters);
+    memset(tile + tailLetters, 'A', sizeof(tile) - tailLetters);
+    decryptHillTile<N>(tile, inverse, plain);
+    memcpy(out + N * b, plain, tailLetters);
+}
+
+template <int N>
+void decryptHillBlocksPortable(const char *cleanLetters, size_t blockCount, const HillMatrix<N> &inverse, char *out) {
+    decryptHillBlocks<N>(cleanLetters, blockCount, inverse, out);
+}
+
+#ifdef HILL_HAVE_X86_KERNELS
+template <int N>
+__attribute__((target("avx2")))
+void decryptHillBlocksAvx2(const char *cleanLetters, size_t blockCount, const HillMatrix<N> &inverse, char *out) {
+    decryptHillBlocks<N>(cleanLetters, blockCount, inverse, out);
+}
+
+template <int N>
+__attribute__((target("avx512f,avx512bw")))
+void decryptHillBlocksAvx512Bw(const char *cleanLetters, size_t blockCount, const HillMatrix<N> &inverse, char *out) {
+    decryptHillBlocks<N>(cleanLetters, blockCount, inverse, out);
+}
+#endif
+
+// Same tile over symbol indices of an alphabet of size modulus, on 32-bit lanes: row sums reach
+// 8 * 255^2, so the reduction uses the ModulusContext's Barrett constants instead of 2521
+template <int N>
+__attribute__((always_inline)) inline void decryptSymbolTile(const uint8_t *symbols, const HillMatrix<N> &inverse,
+                                                             const ModulusContext &context, uint8_t *out) {
+    const uint32_t modulus = (uint32_t)context.modulus, multiplier = context.barrettMultiplier;
+    const int shift = context.barrettShift;
+    alignas(64) uint32_t column[N][HILL_TILE_BLOCKS];
+    alignas(64) uint32_t row[N][HILL_TILE_BLOCKS];
+    for (size_t b = 0; b < HILL_TILE_BLOCKS; ++b)
+        for (int j = 0; j < N; ++j) column[j][b] = symbols[N * b + j];
+    for (int r = 0; r < N; ++r) {
+        uint32_t sum[HILL_TILE_BLOCKS] = {};
+        for (int j = 0; j < N; ++j) {
+            uint32_t k = (uint32_t)inverse[r][j];
+            for (size_t b = 0; b < HILL_TILE_BLOCKS; ++b) sum[b] += k * column[j][b];
+        }
+        for (size_t b = 0; b < HILL_TILE_BLOCKS; ++b) {
+            uint32_t x = sum[b] - ((sum[b] * multiplier) >> shift) * modulus;
+            row[r][b] = x >= modulus ? x - modulus : x;
+        }
+    }
+    for (size_t b = 0; b < HILL_TILE_BLOCKS; ++b)
+        for (int r = 0; r < N; ++r) out[N * b + r] = (uint8_t)row[r][b];
+}
+
+template <int N>
+__attribute__((always_inline)) inline void decryptSymbolBlocks(const uint8_t *symbols, size_t blockCount,
+                                                               const HillMatrix<N> &inverse,
+                                                               const ModulusContext &context, uint8_t *out) {
+    size_t b = 0;
+    for (; b + HILL_TILE_BLOCKS <= blockCount; b += HILL_TILE_BLOCKS)
+        decryptSymbolTile<N>(symbols + N * b, inverse, context, out + N * b);
+    if (b == blockCount) return;
+    uint8_t tile[N * HILL_TILE_BLOCKS] = {}, plain[N * HILL_TILE_BLOCKS];
+    size_t tailSymbols = N * (blockCount - b);
+    memcpy(tile, symbols + N * b, tailSymbols);
+    decryptSymbolTile<N>(tile, inverse, context, plain);
+    memcpy(out + N * b, plain, tailSymbols);
+}
+
+template <int N>
+void decryptSymbolBlocksPortable(const uint8_t *symbols, size_t blockCount, const HillMatrix<N> &inverse,
+                                 const ModulusContext &context, uint8_t *out) {
+    decryptSymbolBlocks<N>(symbols, blockCount, inverse, context, out);
+}
+
+#ifdef HILL_HAVE_X86_KERNELS
+template <int N>
+__attribute__((target("avx2")))
+void decryptSymbolBlocksAvx2(const uint8_t *symbols, size_t blockCount, const HillMatrix<N> &inverse,
+                             const ModulusContext &context, uint8_t *out) {
+    decryptSymbolBlocks<N>(symbols, blockCount, inverse, context, out);
+}
+
+template <int N>
+__attribute__((target("avx512f,avx512bw")))
+void decryptSymbolBlocksAvx512Bw(const uint8_t *symbols, size_t blockCount, const HillMatrix<N> &inverse,
+                                 const ModulusContext &context, uint8_t *out) {
+    decryptSymbolBlocks<N>(symbols, blockCount, inverse, context, out);
+}
+#endif
+
+template <int N>
+struct HillEngine {
+    using Matrix = HillMatrix<N>;
+    using DecryptFunction = void (*)(const char *, size_t, const Matrix &, char *);
+    using SymbolDecryptFunction = void (*)(const uint8_t *, size_t, const Matrix &, const ModulusContext &, uint8_t *);
+
+    static Matrix keyFromString(const string &keyString) {
+        string cleaned = keepLettersUpper(keyString);
+        if (cleaned.size() != (size_t)(N * N))
+            throw runtime_error("Key must contain exactly " + to_string(N * N) + " letters for "
+                                + to_string(N) + "-letter blocks.");
+        Matrix key;
+        for (int i = 0; i < N * N; ++i) key[i / N][i % N] = letterIndex(cleaned[i]);
+        return key;
+    }
+
+    static Matrix keyFromSymbols(const string &keyString, const Alphabet &alphabet) {
+        vector<uint8_t> symbols;
+        alphabet.appendIndices(keyString.data(), keyString.size(), symbols);
+        if (symbols.size() != (size_t)(N * N))
+            throw runtime_error("Key must contain exactly " + to_string(N * N) + " symbols of the " + alphabet.name
+                                + " alphabet for " + to_string(N) + "-symbol blocks.");
+        Matrix key;
+        for (int i = 0; i < N * N; ++i) key[i / N][i % N] = symbols[i];
+        return key;
+    }
+
+    // Gauss-Jordan elimination on [m | I] mod a prime; false when m is singular mod prime.
+    // inverseTable, when given, holds the inverses mod prime.
+    static bool invertModPrime(const Matrix &m, int prime, Matrix &inverse, const uint16_t *inverseTable = nullptr) {
+        int a[N][2 * N];
+        for (int r = 0; r < N; ++r)
+            for (int c = 0; c < N; ++c) {
+                a[r][c] = positiveMod(m[r][c], prime);
+                a[r][N + c] = r == c;
+            }
+        for (int col = 0; col < N; ++col) {
+            int pivot = col;
+            while (pivot < N && a[pivot][col] == 0) ++pivot;
+            if (pivot == N) return false;
+            if (pivot != col)
+                for (int c = 0; c < 2 * N; ++c) swap(a[pivot][c], a[col][c]);
+            int scale = inverseTable ? inverseTable[a[col][col]] : modularInverse(a[col][col], prime);
+            for (int c = 0; c < 2 * N; ++c) a[col][c] = (int)(1LL * a[col][c] * scale % prime);
+            for (int r = 0; r < N; ++r) {
+                if (r == col || a[r][col] == 0) continue;
+                long long negatedFactor = prime - a[r][col];
+                for (int c = 0; c < 2 * N; ++c) a[r][c] = (int)((a[r][c] + negatedFactor * a[col][c]) % prime);
+            }
+        }
+        for (int r = 0; r < N; ++r)
+            for (int c = 0; c < N; ++c) inverse[r][c] = a[r][N + c];
+        return true;
+    }
+
+    static bool tryInvert(const Matrix &key, Matrix &inverse) {
+        Matrix inverseMod2, inverseMod13;
+        if (!invertModPrime(key, MOD_2, inverseMod2) || !invertModPrime(key, MOD_13, inverseMod13)) return false;
+        for (int r = 0; r < N; ++r)
+            for (int c = 0; c < N; ++c) inverse[r][c] = combineResiduesMod26(inverseMod2[r][c], inverseMod13[r][c]);
+        return true;
+    }
+
+    static Matrix invert(const Matrix &key) {
+        Matrix inverse;
+        if (!tryInvert(key, inverse))
+            throw runtime_error("Key matrix is not invertible mod 26 (singular mod 2 or mod 13).");
+        return inverse;
+    }
+
+    // Hensel lifting of an inverse mod p to mod primePower = p^k by Newton's iteration
+    // B <- B (2I - K B): if K B = I mod p^e, the new B satisfies it mod p^2e, so k <= 16 takes at
+    // most four rounds of two N x N products
+    static void liftInverse(const Matrix &key, int prime, int primePower, Matrix &inverse) {
+        const long long q = primePower;
+        for (long long precision = prime; precision < q; precision *= precision) {
+            Matrix correction, lifted;      // correction = 2I - K B mod q
+            for (int r = 0; r < N; ++r)
+                for (int c = 0; c < N; ++c) {
+                    long long sum = 0;
+                    for (int j = 0; j < N; ++j) sum += key[r][j] % q * inverse[j][c];
+                    correction[r][c] = (int)(((r == c ? 2 : 0) + q - sum % q) % q);
+                }
+            for (int r = 0; r < N; ++r)
+                for (int c = 0; c < N; ++c) {
+                    long long sum = 0;
+                    for (int j = 0; j < N; ++j) sum += 1LL * inverse[r][j] * correction[j][c];
+                    lifted[r][c] = (int)(sum % q);
+                }
+            inverse = lifted;
+        }
+    }
+
+    // Inverse mod the context's modulus: one elimination per prime factor, lifted to its prime
+    // power, combined by CRT
+    static bool tryInvert(const Matrix &key, const ModulusContext &context, Matrix &inverse) {
+        vector<Matrix> inverseModPrime(context.primes.size());
+        for (size_t i = 0; i < context.primes.size(); ++i) {
+            if (!invertModPrime(key, context.primes[i], inverseModPrime[i], context.inverseTables[i].data()))
+                return false;
+            if (context.primePowers[i] != context.primes[i])
+                liftInverse(key, context.primes[i], context.primePowers[i], inverseModPrime[i]);
+        }
+        vector<int> residues(context.primes.size());
+        for (int r = 0; r < N; ++r)
+            for (int c = 0; c < N; ++c) {
+                for (size_t i = 0; i < residues.size(); ++i) residues[i] = inverseModPrime[i][r][c];
+                inverse[r][c] = context.combine(residues.data());
+            }
+        return true;
+    }
+
+    static Matrix invert(const Matrix &key, const ModulusContext &context) {
+        Matrix inverse;
+        if (!tryInvert(key, context, inverse))
+            throw runtime_error("Key matrix is not invertible mod " + to_string(context.modulus) + ".");
+        return inverse;
+    }
+
+    // Widest tile loop the CPU supports
+    static DecryptFunction decryptFunction() {
+#ifdef HILL_HAVE_X86_KERNELS
+        if (cpuSupportsAvx512Bw()) return decryptHillBlocksAvx512Bw<N>;
+        if (cpuSupportsAvx2()) return decryptHillBlocksAvx2<N>;
+#endif
+        return decryptHillBlocksPortable<N>;
+    }
+
+    static SymbolDecryptFunction symbolDecryptFunction() {
+#ifdef HILL_HAVE_X86_KERNELS
+        if (cpuSupportsAvx512Bw()) return decryptSymbolBlocksAvx512Bw<N>;
+        if (cpuSupportsAvx2()) return decryptSymbolBlocksAvx2<N>;
+#endif
+        return decryptSymbolBlocksPortable<N>;
+    }
+
+    // streamDecrypt() over an arbitrary alphabet: bytes outside it are dropped, and the plaintext
+    // symbol indices are mapped back to the alphabet's symbols
+    static size_t streamDecryptSymbols(istream &in, ostream &out, const Matrix &inverse, const Alphabet &alphabet,
+                                       const ModulusContext &context, size_t chunkSize, ThreadPool &pool,
+                                       unsigned threadCount) {
+        SymbolDecryptFunction decrypt = symbolDecryptFunction();
+        vector<char> chunk(chunkSize);
+        vector<uint8_t> symbols, plainSymbols;
+        string plaintext;
+        size_t written = 0;
+        auto flushBlocks = [&](size_t blockCount) {
+            plainSymbols.resize(N * blockCount);
+            plaintext.resize(N * blockCount);
+            size_t perTask = (blockCount + threadCount - 1) / max(1u, threadCount);
+            size_t tasks = perTask ? (blockCount + perTask - 1) / perTask : 0;
+            pool.parallelFor(tasks, [&](size_t t) {
+                size_t begin = t * perTask, count = min(perTask, blockCount - begin);
+                decrypt(symbols.data() + N * begin, count, inverse, context, &plainSymbols[N * begin]);
+                for (size_t i = N * begin; i < N * (begin + count); ++i) plaintext[i] = alphabet.symbols[plainSymbols[i]];
+            });
+            out.write(plaintext.data(), (streamsize)plaintext.size());
+            written += plaintext.size();
+            symbols.erase(symbols.begin(), symbols.begin() + N * blockCount);
+        };
+        while (in) {
+            in.read(chunk.data(), (streamsize)chunk.size());
+            size_t got = (size_t)in.gcount();
+            if (got == 0) break;
+            alphabet.appendIndices(chunk.data(), got, symbols);
+            flushBlocks(symbols.size() / N);
+        }
+        if (!symbols.empty()) {
+            symbols.resize(N, (uint8_t)alphabet.index[(unsigned char)alphabet.padding]);
+            flushBlocks(1);
+        }
+        out.flush();
+        if (!out) throw runtime_error("Failed to write plaintext output.");
+        return written;
+    }
+
+    // Decrypt everything readable from in to out, carrying incomplete blocks between chunks and
+    // padding the last one with 'X'. Complete blocks of a chunk are split across the pool.
+    static size_t streamDecrypt(istream &in, ostream &out, const Matrix &inverse, size_t chunkSize, ThreadPool &pool,
+                                unsigned threadCount) {
+        DecryptFunction decrypt = decryptFunction();
+        vector<char> chunk(chunkSize);
+        string letters, plaintext;
+        size_t written = 0;
+        auto flushBlocks = [&](size_t blockCount) {
+            plaintext.resize(N * blockCount);
+            size_t perTask = (blockCount + threadCount - 1) / max(1u, threadCount);
+            size_t tasks = perTask ? (blockCount + perTask - 1) / perTask : 0;
+            pool.parallelFor(tasks, [&](size_t t) {
+                size_t begin = t * perTask, count = min(perTask, blockCount - begin);
+                decrypt(letters.data() + N * begin, count, inverse, &plaintext[N * begin]);
+            });
+            out.write(plaintext.data(), (streamsize)plaintext.size());
+            written += plaintext.size();
+            letters.erase(0, N * blockCount);
+        };
+        while (in) {
+            in.read(chunk.data(), (streamsize)chunk.size());
+            size_t got = (size_t)in.gcount();
+            if (got == 0) break;
+            appendLettersUpper(chunk.data(), got, letters);
+            flushBlocks(letters.size() / N);
+        }
+        if (!letters.empty()) {
+            letters.append(N - letters.size(), 'X');
+            flushBlocks(1);
+        }
+        out.flush();
+        if (!out) throw runtime_error("Failed to write plaintext output.");
+        return written;
+    }
+};
+
+// ---------- Large key inversion ----------
+// Keys of 64 to 1024 (or more) rows are far beyond cofactor expansion, but GF(2) and GF(13) are
+// fields, so each CRT component is inverted by Gauss-Jordan elimination on [K | I] and the two
+// inverses are combined element-wise with combineResiduesMod26(), as for 3x3 keys.
+//  - mod 2: rows are bit vectors, and columns are eliminated M4RI-style, M4RI_TABLE_BITS at a time.
+//    Once the panel's pivot rows form an identity in its columns, every other row is cleared with
+//    one XOR of a precomputed combination, looked up by the row's panel bits.
+//  - mod 13: blocked elimination, MOD_13_PANEL_COLUMNS pivots per panel. Pivots are chosen on a
+//    copy of the panel, the new pivot rows are Q * S (Q the inverse of the pivot block) and every
+//    other row takes a rank-b update against them. The update accumulates products below 13^2 on
+//    16-bit lanes (64 * 144 < 2^16), reduces once per panel, and runs on the thread pool in row
+//    and column blocks of MOD_13_UPDATE_COLUMNS.
+struct LargeKeyMatrix {
+    size_t size = 0;
+    vector<uint8_t> entries;    // row-major, residues mod 26
+
+    uint8_t &at(size_t r, size_t c) { return entries[r * size + c]; }
+    uint8_t at(size_t r, size_t c) const { return entries[r * size + c]; }
+};
+
+const int M4RI_TABLE_BITS = 8;
+const size_t MOD_13_PANEL_COLUMNS = 64;
+const size_t MOD_13_UPDATE_COLUMNS = 256;
+const size_t LARGE_INVERSION_ROW_BLOCK = 64;
+
+LargeKeyMatrix largeKeyFromString(const string &keyString, size_t size) {
+    string cleaned = keepLettersUpper(keyString);
+    if (cleaned.size() != size * size)
+        throw runtime_error("Key must contain exactly " + to_string(size * size) + " letters for "
+                            + to_string(size) + "-letter blocks (got " + to_string(cleaned.size()) + ").");
+    LargeKeyMatrix key;
+    key.size = size;
+    key.entries.resize(size * size);
+    for (size_t i = 0; i < cleaned.size(); ++i) key.entries[i] = (uint8_t)(cleaned[i] - 'A');
+    return key;
+}
+
+inline void xorWords(uint64_t *target, const uint64_t *source, size_t firstWord, size_t words) {
+    for (size_t w = firstWord; w < words; ++w) target[w] ^= source[w];
+}
+
+// inverse receives n * n residues mod 2; false when the key is singular mod 2
+bool invertLargeMod2(const LargeKeyMatrix &key, vector<uint8_t> &inverse, ThreadPool &pool) {
+    size_t n = key.size, words = (2 * n + 63) / 64;
+    vector<uint64_t> bits(n * words);
+    auto row = [&](size_t r) { return &bits[r * words]; };
+    for (size_t r = 0; r < n; ++r) {
+        for (size_t c = 0; c < n; ++c) row(r)[c / 64] |= (uint64_t)(key.at(r, c) & 1) << (c % 64);
+        row(r)[(n + r) / 64] |= 1ULL << ((n + r) % 64);
+    }
+    auto bit = [&](size_t r, size_t c) { return row(r)[c / 64] >> (c % 64) & 1; };
+
+    vector<uint64_t> table(((size_t)1 << M4RI_TABLE_BITS) * words);
+    for (size_t c0 = 0; c0 < n; c0 += M4RI_TABLE_BITS) {
+        size_t width = min<size_t>(M4RI_TABLE_BITS, n - c0), firstWord = c0 / 64;
+        // pivot rows c0..c0+width-1, reduced among themselves to the identity on the panel columns
+        for (size_t i = 0; i < width; ++i) {
+            size_t c = c0 + i, pivot = n;
+            for (size_t r = c; r < n && pivot == n; ++r) {
+                for (size_t j = 0; j < i; ++j)
+                    if (bit(r, c0 + j)) xorWords(row(r), row(c0 + j), firstWord, words);
+                if (bit(r, c)) pivot = r;
+            }
+            if (pivot == n) return false;
+            if (pivot != c) swap_ranges(row(pivot), row(pivot) + words, row(c));
+            for (size_t j = 0; j < i; ++j)
+                if (bit(c0 + j, c)) xorWords(row(c0 + j), row(c), firstWord, words);
+        }
+        // table[mask] = XOR of the pivot rows selected by mask
+        fill(table.begin(), table.begin() + words, 0);
+        for (size_t mask = 1; mask < ((size_t)1 << width); ++mask) {
+            size_t low = mask & (0 - mask);
+            uint64_t *entry = &table[mask * words];
+            const uint64_t *rest = &table[(mask ^ low) * words], *pivotRow = row(c0 + __builtin_ctzll(low));
+            for (size_t w = firstWord; w < words; ++w) entry[w] = rest[w] ^ pivotRow[w];
+        }
+        uint64_t panelMask = ((uint64_t)1 << width) - 1;
+        pool.parallelFor((n + LARGE_INVERSION_ROW_BLOCK - 1) / LARGE_INVERSION_ROW_BLOCK, [&](size_t block) {
+            size_t end = min(n, (block + 1) * LARGE_INVERSION_ROW_BLOCK);
+            for (size_t r = block * LARGE_INVERSION_ROW_BLOCK; r < end; ++r) {
+                if (r >= c0 && r < c0 + width) continue;
+                uint64_t mask = row(r)[firstWord] >> (c0 % 64) & panelMask;
+                if (mask) xorWords(row(r), &table[mask * words], firstWord, words);
+            }
+        });
+    }
+    inverse.assign(n * n, 0);
+    for (size_t r = 0; r < n; ++r)
+        for (size_t c = 0; c < n; ++c) inverse[r * n + c] = (uint8_t)bit(r, n + c);
+    return true;
+}
+
+// Gauss-Jordan inverse of a small b x b block mod 13 (the pivot block of a panel); false when singular
+bool invertSmallMod13(vector<uint8_t> block, size_t b, vector<uint8_t> &inverse) {
+    inverse.assign(b * b, 0);
+    for (size_t i = 0; i < b; ++i) inverse[i * b + i] = 1;
+    for (size_t col = 0; col < b; ++col) {
+        size_t pivot = col;
+        while (pivot < b && block[pivot * b + col] == 0) ++pivot;
+        if (pivot == b) return false;
+        if (pivot != col) {
+            swap_ranges(&block[pivot * b], &block[pivot * b] + b, &block[col * b]);
+            swap_ranges(&inverse[pivot * b], &inverse[pivot * b] + b, &inverse[col * b]);
+        }
+        int scale = INVERSE_MOD_13[block[col * b + col]];
+        for (size_t c = 0; c < b; ++c) {
+            block[col * b + c] = (uint8_t)(block[col * b + c] * scale % MOD_13);
+            inverse[col * b + c] = (uint8_t)(inverse[col * b + c] * scale % MOD_13);
+        }
+        for (size_t r = 0; r < b; ++r) {
+            int factor = block[r * b + col];
+            if (r == col || factor == 0) continue;
+            for (size_t c = 0; c < b; ++c) {
+                block[r * b + c] = (uint8_t)((block[r * b + c] + (MOD_13 - factor) * block[col * b + c]) % MOD_13);
+                inverse[r * b + c] = (uint8_t)((inverse[r * b + c] + (MOD_13 - factor) * inverse[col * b + c]) % MOD_13);
+            }
+        }
+    }
+    return true;
+}
+
+// target[0..MOD_13_UPDATE_COLUMNS) = (target + 13 * 709 - sum_j coefficients[j] * rows[j][...]) mod 13,
+// every coefficient and row entry being below 13 and at most MOD_13_PANEL_COLUMNS rows; the sum
+// stays within 64 * 144 = 9216 < 9217 = 13 * 709, so 16-bit lanes neither wrap nor go negative.
+// The column count is fixed (rows are padded), so the loops compile to whole vectors.
+__attribute__((always_inline)) inline void subtractRowCombinationMod13Lanes(uint8_t *target, const uint8_t *coefficients,
+                                                                          const uint8_t *const *rows, size_t b) {
+    uint16_t sum[MOD_13_UPDATE_COLUMNS] = {};
+    for (size_t j = 0; j < b; ++j) {
+        uint16_t k = coefficients[j];
+        if (k == 0) continue;
+        const uint8_t *source = rows[j];
+        for (size_t c = 0; c < MOD_13_UPDATE_COLUMNS; ++c) sum[c] = (uint16_t)(sum[c] + k * source[c]);
+    }
+    for (size_t c = 0; c < MOD_13_UPDATE_COLUMNS; ++c) {
+        uint16_t value = (uint16_t)(target[c] + 13 * 709 - sum[c]);
+        target[c] = (uint8_t)(value - MOD_13 * ((value * 20165u) >> 18));     // value % 13 for value < 2^18
+    }
+}
+
+void subtractRowCombinationMod13Portable(uint8_t *target, const uint8_t *coefficients, const uint8_t *const *rows,
+                                         size_t b) {
+    subtractRowCombinationMod13Lanes(target, coefficients, rows, b);
+}
+
+#ifdef HILL_HAVE_X86_KERNELS
+__attribute__((target("avx2")))
+void subtractRowCombinationMod13Avx2(uint8_t *target, const uint8_t *coefficients, const uint8_t *const *rows,
+                                     size_t b) {
+    subtractRowCombinationMod13Lanes(target, coefficients, rows, b);
+}
+
+// Eight 32-lane accumulators (256 columns) stay in registers across all b source rows
+static_assert(MOD_13_UPDATE_COLUMNS % 256 == 0, "AVX-512BW row combination works in 256-column strips");
+
+__attribute__((target("avx512f,avx512bw")))
+void subtractRowCombinationMod13Avx512Bw(uint8_t *target, const uint8_t *coefficients, const uint8_t *const *rows,
+                                         size_t b) {
+    const int accumulators = 8;
+    for (size_t strip = 0; strip < MOD_13_UPDATE_COLUMNS; strip += 32 * accumulators) {
+        __m512i sum[accumulators];
+        for (int a = 0; a < accumulators; ++a) sum[a] = _mm512_setzero_si512();
+        for (size_t j = 0; j < b; ++j) {
+            if (coefficients[j] == 0) continue;
+            __m512i k = _mm512_set1_epi16(coefficients[j]);
+            const uint8_t *source = rows[j] + strip;
+            for (int a = 0; a < accumulators; ++a) {
+                __m512i x = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(source + 32 * a)));
+                sum[a] = _mm512_add_epi16(sum[a], _mm512_mullo_epi16(k, x));
+            }
+        }
+        for (int a = 0; a < accumulators; ++a) {
+            uint8_t *out = target + strip + 32 * a;
+            __m512i value = _mm512_sub_epi16(
+                _mm512_add_epi16(_mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)out)),
+                                 _mm512_set1_epi16(13 * 709)), sum[a]);
+            // (value * 5041) >> 16 is floor(value / 13) or one less for value < 9230, so one correction step
+            __m512i quotient = _mm512_mulhi_epu16(value, _mm512_set1_epi16(5041));
+            __m512i residue = _mm512_sub_epi16(value, _mm512_mullo_epi16(quotient, _mm512_set1_epi16(MOD_13)));
+            residue = _mm512_mask_sub_epi16(residue, _mm512_cmpge_epu16_mask(residue, _mm512_set1_epi16(MOD_13)),
+                                            residue, _mm512_set1_epi16(MOD_13));
+            _mm512_mask_cvtepi16_storeu_epi8(out, 0xFFFFFFFF, residue);
+        }
+    }
+}
+#endif
+
+using RowCombinationFunction = void (*)(uint8_t *, const uint8_t *, const uint8_t *const *, size_t);
+
+RowCombinationFunction rowCombinationMod13Function() {
+#ifdef HILL_HAVE_X86_KERNELS
+    if (cpuSupportsAvx512Bw()) return subtractRowCombinationMod13Avx512Bw;
+    if (cpuSupportsAvx2()) return subtractRowCombinationMod13Avx2;
+#endif
+    return subtractRowCombinationMod13Portable;
+}
+
+// inverse receives n * n residues mod 13; false when the key is singular mod 13
+bool invertLargeMod13(const LargeKeyMatrix &key, vector<uint8_t> &inverse, ThreadPool &pool) {
+    // rows padded so that every column block starting at a panel column is a full block
+    size_t n = key.size, width = 2 * n + MOD_13_UPDATE_COLUMNS;
+    vector<uint8_t> m(n * width, 0);
+    RowCombinationFunction subtractRowCombination = rowCombinationMod13Function();
+    for (size_t r = 0; r < n; ++r) {
+        for (size_t c = 0; c < n; ++c) m[r * width + c] = key.at(r, c) % MOD_13;
+        m[r * width + n + r] = 1;
+    }
+    auto row = [&](size_t r) { return &m[r * width]; };
+
+    vector<uint8_t> panel, pivotBlock, pivotInverse, coefficients, newPivotRows;
+    vector<size_t> reducedThrough;      // pivots already applied to each row of the panel copy
+    vector<size_t> order(n);            // key row now at each position
+    iota(order.begin(), order.end(), (size_t)0);
+    for (size_t c0 = 0; c0 < n; c0 += MOD_13_PANEL_COLUMNS) {
+        size_t b = min(MOD_13_PANEL_COLUMNS, n - c0), rowsBelow = n - c0;
+        size_t columnBlocks = (n + b + MOD_13_UPDATE_COLUMNS - 1) / MOD_13_UPDATE_COLUMNS;
+        size_t span = columnBlocks * MOD_13_UPDATE_COLUMNS;
+        // choose pivots on a copy of the panel; row swaps go to the matrix too. A candidate is reduced
+        // by the pivots chosen so far only when it is examined, about one row per column for random keys
+        panel.resize(rowsBelow * b);
+        for (size_t r = 0; r < rowsBelow; ++r) copy(row(c0 + r) + c0, row(c0 + r) + c0 + b, &panel[r * b]);
+        reducedThrough.assign(rowsBelow, 0);
+        for (size_t i = 0; i < b; ++i) {
+            size_t pivot = rowsBelow;
+            for (size_t r = i; r < rowsBelow && pivot == rowsBelow; ++r) {
+                uint8_t *candidate = &panel[r * b];
+                for (size_t j = reducedThrough[r]; j < i; ++j) {
+                    int factor = candidate[j];
+                    if (factor == 0) continue;
+                    for (size_t c = j; c < b; ++c)
+                        candidate[c] = (uint8_t)((candidate[c] + (MOD_13 - factor) * panel[j * b + c]) % MOD_13);
+                }
+                reducedThrough[r] = i;
+                if (candidate[i]) pivot = r;
+            }
+            if (pivot == rowsBelow) return false;
+            if (pivot != i) {
+                swap_ranges(&panel[pivot * b], &panel[pivot * b] + b, &panel[i * b]);
+                swap(reducedThrough[pivot], reducedThrough[i]);
+                swap_ranges(row(c0 + pivot), row(c0 + pivot) + n + c0, row(c0 + i));
+                swap(order[c0 + pivot], order[c0 + i]);
+            }
+            int scale = INVERSE_MOD_13[panel[i * b + i]];
+            for (size_t c = i; c < b; ++c) panel[i * b + c] = (uint8_t)(panel[i * b + c] * scale % MOD_13);
+        }
+        // every row's panel entries before the update are its elimination coefficients
+        coefficients.resize(n * b);
+        for (size_t r = 0; r < n; ++r) copy(row(r) + c0, row(r) + c0 + b, &coefficients[r * b]);
+        pivotBlock.assign(coefficients.begin() + c0 * b, coefficients.begin() + (c0 + b) * b);
+        if (!invertSmallMod13(pivotBlock, b, pivotInverse)) return false;
+
+        // new pivot rows Q * S over columns c0..n+c0+b, where S are the current pivot rows
+        newPivotRows.assign(b * span, 0);
+        vector<const uint8_t *> pivotRows(b), newRows(b);
+        for (size_t j = 0; j < b; ++j) {
+            pivotRows[j] = row(c0 + j) + c0;
+            newRows[j] = &newPivotRows[j * span];
+        }
+        pool.parallelFor(columnBlocks, [&](size_t block) {
+            size_t begin = block * MOD_13_UPDATE_COLUMNS;
+            vector<const uint8_t *> sources(b);
+            for (size_t j = 0; j < b; ++j) sources[j] = pivotRows[j] + begin;
+            vector<uint8_t> negated(b);
+            for (size_t i = 0; i < b; ++i) {
+                // Q * S = 0 - (-Q) * S, so the subtract-combination helper computes it from zero
+                for (size_t j = 0; j < b; ++j) negated[j] = (uint8_t)((MOD_13 - pivotInverse[i * b + j]) % MOD_13);
+                subtractRowCombination(&newPivotRows[i * span + begin], negated.data(), sources.data(), b);
+            }
+        });
+
+        // every other row: row -= coefficients * new pivot rows, in row and column blocks
+        size_t rowBlocks = (n + LARGE_INVERSION_ROW_BLOCK - 1) / LARGE_INVERSION_ROW_BLOCK;
+        pool.parallelFor(rowBlocks * columnBlocks, [&](size_t task) {
+            size_t rowBlock = task / columnBlocks, columnBlock = task % columnBlocks;
+            size_t begin = columnBlock * MOD_13_UPDATE_COLUMNS;
+            vector<const uint8_t *> sources(b);
+            for (size_t j = 0; j < b; ++j) sources[j] = newRows[j] + begin;
+            size_t end = min(n, (rowBlock + 1) * LARGE_INVERSION_ROW_BLOCK);
+            for (size_t r = rowBlock * LARGE_INVERSION_ROW_BLOCK; r < end; ++r) {
+                if (r >= c0 && r < c0 + b) continue;
+                subtractRowCombination(row(r) + c0 + begin, &coefficients[r * b], sources.data(), b);
+            }
+        });
+        for (size_t j = 0; j < b; ++j) copy(newRows[j], newRows[j] + span, row(c0 + j) + c0);
+    }
+    inverse.resize(n * n);
+    for (size_t r = 0; r < n; ++r)
+        for (size_t c = 0; c < n; ++c) inverse[r * n + order[c]] = row(r)[n + c];
+    return true;
+}
+
+struct LargeInversionTiming {
+    double mod2Seconds = 0.0, mod13Seconds = 0.0;
+};
+
+// Inverse of key mod 26 through the mod-2 and mod-13 eliminations; false when key is singular mod 26
+bool tryInvertLargeKeyMod26(const LargeKeyMatrix &key, LargeKeyMatrix &inverse, ThreadPool &pool,
+                            LargeInversionTiming *timing = nullptr) {
+    vector<uint8_t> inverseMod2, inverseMod13;
+    auto start = chrono::steady_clock::now();
+    bool invertible = invertLargeMod2(key, inverseMod2, pool);
+    auto middle = chrono::steady_clock::now();
+    invertible = invertible && invertLargeMod13(key, inverseMod13, pool);
+    auto end = chrono::steady_clock::now();
+    if (timing) {
+        timing->mod2Seconds = chrono::duration<double>(middle - start).count();
+        timing->mod13Seconds = chrono::duration<double>(end - middle).count();
+    }
+    if (!invertible) return false;
+    inverse.size = key.size;
+    inverse.entries.resize(key.entries.size());
+    for (size_t i = 0; i < inverse.entries.size(); ++i)
+        inverse.entries[i] = (uint8_t)combineResiduesMod26(inverseMod2[i], inverseMod13[i]);
+    return true;
+}
+
+// ---------- Memory-mapped file decryption ----------
+struct MappedDecryptStats {
+    size_t inputBytes = 0;
+    size_t outputBytes = 0;
+    double seconds = 0.0;
+};
+
+#ifdef HILL_HAVE_MMAP
+const size_t MAPPED_WINDOW_SIZE = 1 << 16;
+const size_t MAPPED_PARALLEL_WINDOW_SIZE = 1 << 22;  // per thread
+
+// Decrypt inputPath into outputPath without iostreams: the input is mapped read-only, the
+// output file is sized up front (letters <= input bytes, plus at most 2 padding letters),
+// mapped writable and filled directly, then truncated to the real plaintext length.
+MappedDecryptStats decryptFileMemoryMapped(const string &inputPath, const string &outputPath,
+                                           const Matrix3x3 &inverseKeyMatrix, bool useHugePages,
+                                           DecodeEngine engine, unsigned threadCount = 1) {
+    MappedDecryptStats stats;
+    auto startTime = chrono::steady_clock::now();
+
+    int inputFd = open(inputPath.c_str(), O_RDONLY);
+    if (inputFd < 0) throw runtime_error("Cannot open input file: " + inputPath);
+    struct stat inputStat;
+    if (fstat(inputFd, &inputStat) != 0) {
+        close(inputFd);
+        throw runtime_error("Cannot stat input file: " + inputPath);
+    }
+    size_t inputSize = (size_t)inputStat.st_size;
+    stats.inputBytes = inputSize;
+
+    int outputFd = open(outputPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (outputFd < 0) {
+        close(inputFd);
+        throw runtime_error("Cannot open output file: " + outputPath);
+    }
+    if (inputSize == 0) {
+        close(inputFd);
+        close(outputFd);
+        return stats;
+    }
+
+    size_t outputCapacity = inputSize + 2;
+    if (ftruncate(outputFd, (off_t)outputCapacity) != 0) {
+        close(inputFd);
+        close(outputFd);
+        throw runtime_error("Cannot size output file: " + outputPath);
+    }
+
+    PreparedInverseKey key = prepareInverseKey(inverseKeyMatrix, inputSize / 3, engine);
+    void *inputMap = mmap(nullptr, inputSize, PROT_READ, MAP_PRIVATE, inputFd, 0);
+    void *outputMap = mmap(nullptr, outputCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, outputFd, 0);
+    if (inputMap == MAP_FAILED || outputMap == MAP_FAILED) {
+        if (inputMap != MAP_FAILED) munmap(inputMap, inputSize);
+        if (outputMap != MAP_FAILED) munmap(outputMap, outputCapacity);
+        close(inputFd);
+        close(outputFd);
+        throw runtime_error("mmap failed for " + inputPath + " or " + outputPath);
+    }
+    madvise(inputMap, inputSize, MADV_SEQUENTIAL);
+    madvise(outputMap, outputCapacity, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    if (useHugePages) {
+        madvise(inputMap, inputSize, MADV_HUGEPAGE);
+        madvise(outputMap, outputCapacity, MADV_HUGEPAGE);
+    }
+#else
+    (void)useHugePages;
+#endif
+
+    const char *input = (const char *)inputMap;
+    char *output = (char *)outputMap;
+    size_t written = 0;
+    ThreadPool pool(threadCount);
+    WindowDecryptor decryptor(key, pool);
+    size_t windowSize = pool.size() > 1 ? MAPPED_PARALLEL_WINDOW_SIZE * pool.size() : MAPPED_WINDOW_SIZE;
+    for (size_t offset = 0; offset < inputSize; offset += windowSize) {
+        size_t length = min(windowSize, inputSize - offset);
+        written += decryptor.decryptWindow(input + offset, length, output + written);
+    }
+    written += decryptor.finish(output + written);
+
+    munmap(inputMap, inputSize);
+    munmap(outputMap, outputCapacity);
+    close(inputFd);
+    int truncateResult = ftruncate(outputFd, (off_t)written);
+    close(outputFd);
+    if (truncateResult != 0) throw runtime_error("Cannot truncate output file: " + outputPath);
+
+    stats.outputBytes = written;
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    return stats;
+}
+#else
+MappedDecryptStats decryptFileMemoryMapped(const string &, const string &, const Matrix3x3 &, bool, DecodeEngine,
+                                           unsigned = 1) {
+    throw runtime_error("Memory-mapped mode is not supported on this platform.");
+}
+#endif
+
+// ---------- English letter statistics ----------
+// Relative letter frequencies of English text (percent), A-Z
+const double ENGLISH_LETTER_FREQUENCIES[26] = {
+    8.167, 1.492, 2.782, 4.253, 12.702, 2.228, 2.015, 6.094, 6.966, 0.153, 0.772, 4.025, 2.406,
+    6.749, 7.507, 1.929, 0.095, 5.987, 6.327, 9.056, 2.758, 0.978, 2.360, 0.150, 1.974, 0.074
+};
+
+struct EnglishLogFrequencies {
+    double logProbability[26];
+
+    EnglishLogFrequencies() {
+        for (int i = 0; i < 26; ++i) logProbability[i] = log(ENGLISH_LETTER_FREQUENCIES[i] / 100.0);
+    }
+};
+const EnglishLogFrequencies ENGLISH_LOG_FREQUENCIES;
+
+// Mean log-likelihood per letter of the plaintext that inverseKey gives for the first blockCount
+// blocks of cipher (letter indices); English text scores around -2.9, random letters around -3.6
+double englishFitness(const uint8_t *cipher, size_t blockCount, const Matrix3x3 &inverseKey) {
+    if (blockCount == 0) return 0.0;
+    double total = 0.0;
+    for (size_t b = 0; b < blockCount; ++b) {
+        const uint8_t *y = cipher + 3 * b;
+        for (int r = 0; r < 3; ++r)
+            total += ENGLISH_LOG_FREQUENCIES.logProbability[(inverseKey[r][0] * y[0] + inverseKey[r][1] * y[1]
+                                                             + inverseKey[r][2] * y[2]) % MOD_26];
+    }
+    return total / (3.0 * blockCount);
+}
+
+// Candidate key produced by an attack, with the score it is ranked by
+struct RankedKey {
+    Matrix3x3 key, inverse;
+    double fitness = 0.0;
+    size_t occurrences = 0;     // crib placements yielding this key (crib drag)
+    size_t firstOffset = 0;     // ciphertext letter offset of the first such placement
+};
+
+// ---------- Known-plaintext key recovery ----------
+// Encryption is c = K p per block, so three independent plaintext blocks P = [p1 p2 p3] (as
+// columns) and their ciphertext blocks C give K = C P^-1. P only has to be invertible modulo each
+// prime on its own: K is solved mod 2 and mod 13 from (possibly different) block triples and the
+// residues are combined via CRT. Short cribs often span fewer than three dimensions mod 2 (all
+// letters of one parity in some position); the basis is then completed with unit vectors whose
+// images are unknown and enumerated, so the crib yields every key consistent with it.
+const int CRIB_PRIMES[2] = { MOD_2, MOD_13 };
+
+// Inverse of m modulo a prime; false when the determinant vanishes mod prime
+bool invertMatrixModPrime(const Matrix3x3 &m, int prime, Matrix3x3 &inverse) {
+    int det = positiveMod(determinant3x3(m), prime);
+    if (det == 0) return false;
+    inverse = scalarMultiplyMatrixMod(matrixMod(adjugate3x3(m), prime), modularInverse(det, prime), prime);
+    return true;
+}
+
+Matrix3x3 multiplyMatricesMod(const Matrix3x3 &a, const Matrix3x3 &b, int mod) {
+    Matrix3x3 out;
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+            out[r][c] = (a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c]) % mod;
+    return out;
+}
+
+// Letter indices (0-25) of the letters in text
+vector<uint8_t> letterIndices(const string &text) {
+    vector<uint8_t> indices;
+    indices.reserve(text.size());
+    for (char ch : text) {
+        uint8_t index = LETTER_INDEX_TABLE[ch];
+        if (index != NOT_A_LETTER) indices.push_back(index);
+    }
+    return indices;
+}
+
+// Crib reduced to whole blocks. For each prime: the first `rank` basis columns are independent crib
+// blocks, the rest are unit vectors completing the basis, and basisInverse is precomputed so each
+// placement of the crib costs a few small matrix products plus verification.
+struct CribSystem {
+    vector<uint8_t> plain;          // letter indices, a whole number of blocks
+    size_t blockCount = 0;
+    int rank[2];                    // dimension spanned by the crib blocks mod 2 / mod 13
+    size_t basisBlocks[2][3];       // crib block behind each of the first rank[p] basis columns
+    Matrix3x3 basisInverse[2];      // (basis columns)^-1 mod 2 / mod 13
+    size_t candidatesPerPlacement[2];   // prime^(3 * (3 - rank)) assignments of the unknown columns
+};
+
+// Incremental independence test mod prime: keeps the accepted vectors in reduced form (pivot 1)
+struct ModPrimeSpan {
+    int prime;
+    int rank = 0;
+    array<int,3> rows[3];
+    int pivots[3];
+
+    explicit ModPrimeSpan(int prime) : prime(prime) {}
+
+    // Adds v when it lies outside the span; returns whether it was added
+    bool add(array<int,3> v) {
+        for (int i = 0; i < rank; ++i) {
+            int factor = v[pivots[i]];
+            for (int c = 0; c < 3; ++c) v[c] = positiveMod(v[c] - factor * rows[i][c], prime);
+        }
+        int pivot = 0;
+        while (pivot < 3 && v[pivot] % prime == 0) ++pivot;
+        if (pivot == 3) return false;
+        int scale = modularInverse(positiveMod(v[pivot], prime), prime);
+        for (int c = 0; c < 3; ++c) v[c] = positiveMod(v[c] * scale, prime);
+        rows[rank] = v;
+        pivots[rank++] = pivot;
+        return true;
+    }
+};
+
+CribSystem buildCribSystem(const vector<uint8_t> &cribLetters) {
+    CribSystem crib;
+    crib.blockCount = cribLetters.size() / 3;
+    crib.plain.assign(cribLetters.begin(), cribLetters.begin() + 3 * crib.blockCount);
+    for (int p = 0; p < 2; ++p) {
+        int prime = CRIB_PRIMES[p];
+        ModPrimeSpan span(prime);
+        Matrix3x3 basis;
+        for (size_t b = 0; b < crib.blockCount && span.rank < 3; ++b) {
+            const uint8_t *x = &crib.plain[3 * b];
+            if (!span.add({x[0], x[1], x[2]})) continue;
+            crib.basisBlocks[p][span.rank - 1] = b;
+            for (int r = 0; r < 3; ++r) basis[r][span.rank - 1] = x[r] % prime;
+        }
+        crib.rank[p] = span.rank;
+        for (int e = 0; e < 3 && span.rank < 3; ++e) {
+            array<int,3> unit{};
+            unit[e] = 1;
+            if (!span.add(unit)) continue;
+            for (int r = 0; r < 3; ++r) basis[r][span.rank - 1] = unit[r];
+        }
+        invertMatrixModPrime(basis, prime, crib.basisInverse[p]);
+        size_t unknowns = 3 * (3 - crib.rank[p]);
+        crib.candidatesPerPlacement[p] = 1;
+        for (size_t u = 0; u < unknowns; ++u) crib.candidatesPerPlacement[p] *= prime;
+    }
+    if (crib.rank[1] < 2)
+        throw runtime_error("Crib spans fewer than 2 dimensions modulo 13; it cannot narrow the key down.");
+    return crib;
+}
+
+// Keys mod prime that map the crib onto cipher (block-aligned letter indices) and are invertible
+void solveCribModPrime(const CribSystem &crib, int p, const uint8_t *cipher, vector<Matrix3x3> &keys) {
+    int prime = CRIB_PRIMES[p], rank = crib.rank[p];
+    keys.clear();
+    Matrix3x3 images;   // K times each basis column
+    for (int c = 0; c < rank; ++c)
+        for (int r = 0; r < 3; ++r) images[r][c] = cipher[3 * crib.basisBlocks[p][c] + r] % prime;
+    for (size_t assignment = 0; assignment < crib.candidatesPerPlacement[p]; ++assignment) {
+        size_t digits = assignment;
+        for (int c = rank; c < 3; ++c)
+            for (int r = 0; r < 3; ++r, digits /= prime) images[r][c] = (int)(digits % prime);
+        Matrix3x3 k = multiplyMatricesMod(images, crib.basisInverse[p], prime);
+        bool consistent = true;
+        for (size_t b = 0; b < crib.blockCount && consistent; ++b) {
+            const uint8_t *x = &crib.plain[3 * b], *y = cipher + 3 * b;
+            for (int r = 0; r < 3; ++r)
+                consistent &= (k[r][0] * x[0] + k[r][1] * x[1] + k[r][2] * x[2] - y[r]) % prime == 0;
+        }
+        if (consistent && positiveMod(determinant3x3(k), prime) != 0) keys.push_back(k);
+    }
+}
+
+// Every invertible key mapping the crib onto cipher. Solving mod 2 first rejects most wrong
+// placements after a few parity checks, before any mod-13 work.
+void solveKeysFromCrib(const CribSystem &crib, const uint8_t *cipher, vector<Matrix3x3> &keysMod2,
+                       vector<Matrix3x3> &keysMod13, vector<Matrix3x3> &keys) {
+    keys.clear();
+    solveCribModPrime(crib, 0, cipher, keysMod2);
+    if (keysMod2.empty()) return;
+    solveCribModPrime(crib, 1, cipher, keysMod13);
+    for (const Matrix3x3 &k2 : keysMod2)
+        for (const Matrix3x3 &k13 : keysMod13) {
+            Matrix3x3 key;
+            for (int r = 0; r < 3; ++r)
+                for (int c = 0; c < 3; ++c) key[r][c] = combineResiduesMod26(k2[r][c], k13[r][c]);
+            keys.push_back(key);
+        }
+}
+
+// ---------- Invertible key enumeration ----------
+// GL(3, Z26) is the CRT product of GL(3, Z2) (168 matrices) and GL(3, Z13): a matrix is invertible
+// mod 26 iff it is invertible mod 2 and mod 13, and its inverse is the element-wise CRT of the two
+// inverses. Keys are numbered index = i13 * 168 + i2. A GL(3, Z13) index is three digits choosing
+// each row among the vectors outside the span of the rows above it (2196, 2184 and 2028 choices),
+// so only invertible keys are produced and any index range can serve as a shard.
+const uint64_t GL3_MOD_2_ORDER = 168;
+const uint64_t GL3_MOD_13_ROW_CHOICES[3] = { 2196, 2184, 2028 };
+const uint64_t GL3_MOD_13_ORDER = 2196ULL * 2184 * 2028;
+const uint64_t INVERTIBLE_KEY_COUNT = GL3_MOD_2_ORDER * GL3_MOD_13_ORDER;
+
+struct Gl3Mod2Table {
+    Matrix3x3 matrices[GL3_MOD_2_ORDER], inverses[GL3_MOD_2_ORDER];
+
+    Gl3Mod2Table() {
+        int count = 0;
+        for (int code = 0; code < 512; ++code) {
+            Matrix3x3 m;
+            for (int e = 0; e < 9; ++e) m[e / 3][e % 3] = code >> (8 - e) & 1;
+            if (invertMatrixModPrime(m, MOD_2, inverses[count])) matrices[count++] = m;
+        }
+    }
+};
+const Gl3Mod2Table GL3_MOD_2;
+
+// combineResiduesMod26 for every residue pair
+struct CrtCombineTable {
+    uint8_t value[2][13];
+
+    CrtCombineTable() {
+        for (int r2 = 0; r2 < 2; ++r2)
+            for (int r13 = 0; r13 < 13; ++r13) value[r2][r13] = (uint8_t)combineResiduesMod26(r2, r13);
+    }
+};
+const CrtCombineTable CRT_COMBINE;
+
+// Streams the keys of GL(3, Z26) with their inverses, in index order from a starting index
+class InvertibleKeyEnumerator {
+public:
+    explicit InvertibleKeyEnumerator(uint64_t index) {
+        if (index > INVERTIBLE_KEY_COUNT) throw runtime_error("Key index out of range.");
+        position = index;
+        mod2Index = (int)(index % GL3_MOD_2_ORDER);
+        uint64_t indexMod13 = index / GL3_MOD_2_ORDER;
+        digits[2] = (int)(indexMod13 % GL3_MOD_13_ROW_CHOICES[2]);
+        indexMod13 /= GL3_MOD_13_ROW_CHOICES[2];
+        digits[1] = (int)(indexMod13 % GL3_MOD_13_ROW_CHOICES[1]);
+        digits[0] = (int)(indexMod13 / GL3_MOD_13_ROW_CHOICES[1]);
+        if (position < INVERTIBLE_KEY_COUNT) loadRows(0);
+    }
+
+    // Writes the current key and its inverse and advances; false once past the last key
+    bool next(Matrix3x3 &key, Matrix3x3 &inverse) {
+        if (position >= INVERTIBLE_KEY_COUNT) return false;
+        const Matrix3x3 &key2 = GL3_MOD_2.matrices[mod2Index], &inverse2 = GL3_MOD_2.inverses[mod2Index];
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c) {
+                key[r][c] = CRT_COMBINE.value[key2[r][c]][key13[r][c]];
+                inverse[r][c] = CRT_COMBINE.value[inverse2[r][c]][inverse13[r][c]];
+            }
+        ++position;
+        if (++mod2Index == (int)GL3_MOD_2_ORDER && position < INVERTIBLE_KEY_COUNT) {
+            mod2Index = 0;
+            if (++digits[2] < (int)GL3_MOD_13_ROW_CHOICES[2]) loadRows(2);
+            else if (digits[2] = 0, ++digits[1] < (int)GL3_MOD_13_ROW_CHOICES[1]) loadRows(1);
+            else {
+                digits[1] = 0;
+                ++digits[0];
+                loadRows(0);
+            }
+        }
+        return true;
+    }
+
+private:
+    // Row codes (base 13) outside the span of the given rows, ascending
+    static vector<uint16_t> outsideSpan(const int *rowCodes, int rowCount) {
+        vector<bool> inSpan(13 * 13 * 13);
+        for (int a = 0; a < 13; ++a)
+            for (int b = 0; b < (rowCount > 1 ? 13 : 1); ++b) {
+                int code = 0;
+                for (int place = 169; place >= 1; place /= 13) {
+                    int digitA = rowCodes[0] / place % 13, digitB = rowCount > 1 ? rowCodes[1] / place % 13 : 0;
+                    code = code * 13 + (a * digitA + b * digitB) % 13;
+                }
+                inSpan[code] = true;
+            }
+        vector<uint16_t> codes;
+        for (int code = 0; code < 13 * 13 * 13; ++code)
+            if (!inSpan[code]) codes.push_back((uint16_t)code);
+        return codes;
+    }
+
+    // Re-derives rows from `from` onwards (choice lists only change when an earlier row does)
+    void loadRows(int from) {
+        if (from == 0) {
+            rowCodes[0] = digits[0] + 1;    // every nonzero vector
+            rowChoices[1] = outsideSpan(rowCodes, 1);
+        }
+        if (from <= 1) {
+            rowCodes[1] = rowChoices[1][digits[1]];
+            rowChoices[2] = outsideSpan(rowCodes, 2);
+        }
+        rowCodes[2] = rowChoices[2][digits[2]];
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c) key13[r][c] = rowCodes[r] / (c == 0 ? 169 : c == 1 ? 13 : 1) % 13;
+        invertMatrixModPrime(key13, MOD_13, inverse13);
+    }
+
+    uint64_t position;
+    int mod2Index;
+    int digits[3];
+    int rowCodes[3];
+    vector<uint16_t> rowChoices[3];
+    Matrix3x3 key13, inverse13;
+};
+
+// ---------- Gray-code key sweep ----------
+// Walks raw key indices 0..26^9-1 (base-26 digits, the last key letter least significant) in
+// reflected Gray-code order: digit j of the code is a_j, or 25 - a_j when a_(j+1) is odd, so each
+// step changes a single key entry by +-1. The determinant is linear in every entry,
+// det(K + d E_rc) = det(K) + d C_rc, so it is updated from the cofactor of the changed entry; only
+// the four cofactors whose 2x2 minors contain that entry are then recomputed. Determinant and
+// cofactors are kept as exact integers (|det| <= 6 * 25^3), so a step needs no reduction; the
+// mod-2 and mod-13 invertibility test is one remainder and a table lookup, and the inverse is
+// formed only for invertible keys, as the adjugate scaled by the CRT-combined determinant inverse.
+const uint64_t RAW_KEY_COUNT = 5429503678976ULL;    // 26^9
+
+// For det mod 26 in -25..25 (index + 25): the inverse of det mod 26, or 0 when det is not a unit
+struct UnitInverseMod26Table {
+    uint8_t inverse[51];
+
+    UnitInverseMod26Table() {
+        for (int d = -25; d <= 25; ++d) {
+            int residue = positiveMod(d, MOD_26);
+            inverse[d + 25] = residue % 2 && residue % 13
+                                  ? (uint8_t)combineResiduesMod26(1, INVERSE_MOD_13[residue % 13]) : 0;
+        }
+    }
+};
+const UnitInverseMod26Table UNIT_INVERSE_MOD_26;
+
+class GrayCodeKeyIterator {
+public:
+    explicit GrayCodeKeyIterator(uint64_t index) : position(index) {
+        if (index >= RAW_KEY_COUNT) throw runtime_error("Key index out of range.");
+        for (int j = 0; j < 9; ++j, index /= 26) digits[j] = (int)(index % 26);
+        digits[9] = 0;
+        for (int j = 0; j < 9; ++j) {
+            int entry = 8 - j;
+            key[entry / 3][entry % 3] = digits[j + 1] % 2 ? 25 - digits[j] : digits[j];
+        }
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c) updateCofactor(r, c);
+        determinant = determinant3x3(key);
+    }
+
+    const Matrix3x3 &current() const { return key; }
+    int determinantMod26() const { return positiveMod(determinant, MOD_26); }
+    bool isInvertible() const { return UNIT_INVERSE_MOD_26.inverse[determinant % MOD_26 + 25] != 0; }
+
+    // Inverse of the current key; only valid when isInvertible()
+    void inverse(Matrix3x3 &out) const {
+        int determinantInverse = UNIT_INVERSE_MOD_26.inverse[determinant % MOD_26 + 25];
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c) out[r][c] = positiveMod(cofactor[c][r] * determinantInverse, MOD_26);
+    }
+
+    // Steps to the next index; false after the last key
+    bool advance() {
+        if (++position >= RAW_KEY_COUNT) return false;
+        int j = 0;
+        while (digits[j] == 25) digits[j++] = 0;
+        ++digits[j];
+        int delta = digits[j + 1] % 2 ? -1 : 1;
+        int entry = 8 - j, r = entry / 3, c = entry % 3;
+        key[r][c] += delta;
+        determinant += delta * cofactor[r][c];
+        for (int i = 1; i < 3; ++i)
+            for (int k = 1; k < 3; ++k) updateCofactor((r + i) % 3, (c + k) % 3);
+        return true;
+    }
+
+private:
+    // Cyclic index order gives each 3x3 cofactor its sign without a separate (-1)^(r+c)
+    void updateCofactor(int r, int c) {
+        int r1 = (r + 1) % 3, r2 = (r + 2) % 3, c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+        cofactor[r][c] = key[r1][c1] * key[r2][c2] - key[r1][c2] * key[r2][c1];
+    }
+
+    uint64_t position;
+    int digits[10];     // base-26 digits of the index, digits[9] = 0
+    Matrix3x3 key, cofactor;
+    int determinant;    // exact
+};
+
+// ---------- Ciphertext block histogram ----------
+// Attack scores only depend on how often each ciphertext block occurs, not on where, so the
+// message is collapsed once into counts of its distinct blocks (at most 26^3) and every candidate
+// is scored over that list: the per-candidate cost no longer grows with the message length.
+// Folding the histogram mod a prime merges blocks with equal residues (at most 13^3 or 8 entries).
+struct UniqueBlock {
+    uint8_t letters[3];     // letter indices, or residues mod the fold prime
+    uint64_t count;
+};
+
+struct BlockHistogram {
+    vector<UniqueBlock> blocks;
+    uint64_t blockCount = 0;
+};
+
+// Streams letter indices into dense 26^3 counts; a block split across add() calls is carried over
+class BlockHistogramBuilder {
+public:
+    BlockHistogramBuilder() : counts(TRIGRAM_COUNT) {}
+
+    void add(const uint8_t *letters, size_t size) {
+        size_t k = 0;
+        while (pendingCount > 0 && pendingCount < 3 && k < size) pending[pendingCount++] = letters[k++];
+        if (pendingCount == 3) {
+            ++counts[(pending[0] * 26 + pending[1]) * 26 + pending[2]];
+            pendingCount = 0;
+        }
+        for (; k + 3 <= size; k += 3) ++counts[(letters[k] * 26 + letters[k + 1]) * 26 + letters[k + 2]];
+        while (k < size) pending[pendingCount++] = letters[k++];
+    }
+
+    BlockHistogram finish() const {
+        BlockHistogram histogram;
+        for (int code = 0; code < TRIGRAM_COUNT; ++code) {
+            if (counts[code] == 0) continue;
+            histogram.blocks.push_back({ { (uint8_t)(code / 676), (uint8_t)(code / 26 % 26), (uint8_t)(code % 26) },
+                                         counts[code] });
+            histogram.blockCount += counts[code];
+        }
+        return histogram;
+    }
+
+private:
+    vector<uint64_t> counts;
+    uint8_t pending[3];
+    int pendingCount = 0;
+};
+
+BlockHistogram buildBlockHistogram(const vector<uint8_t> &cipher) {
+    BlockHistogramBuilder builder;
+    builder.add(cipher.data(), cipher.size());
+    return builder.finish();
+}
+
+BlockHistogram foldBlockHistogram(const BlockHistogram &histogram, int prime) {
+    vector<uint64_t> counts(prime * prime * prime);
+    for (const UniqueBlock &block : histogram.blocks)
+        counts[(block.letters[0] % prime * prime + block.letters[1] % prime) * prime + block.letters[2] % prime]
+            += block.count;
+    BlockHistogram folded;
+    folded.blockCount = histogram.blockCount;
+    for (int code = 0; code < (int)counts.size(); ++code)
+        if (counts[code])
+            folded.blocks.push_back({ { (uint8_t)(code / (prime * prime)), (uint8_t)(code / prime % prime),
+                                        (uint8_t)(code % prime) }, counts[code] });
+    return folded;
+}
+
+// ---------- Ciphertext-only row search ----------
+// Plaintext letter r of every block depends only on row r of the inverse key, so each row can be
+// searched on its own: all 26^3 candidate rows are scored by English unigram fitness over the
+// whole message. The score does not depend on which row the candidate is used for, so one sweep
+// serves all three positions. The best rows are then assembled into ordered triples; the unigram
+// score of a triple is the same in every order, so the order is chosen by common bigrams.
+const int ROW_CANDIDATE_COUNT = 26 * 26 * 26;
+const double BIGRAM_WEIGHT = 1.0;
+
+struct RowCandidate {
+    array<int,3> row;
+    double fitness;
+};
+
+array<int,3> rowFromCode(int code) {
+    return { code / (26 * 26), code / 26 % 26, code % 26 };
+}
+
+// Most frequent English bigrams; about 35% of adjacent letter pairs in English text fall in this
+// set, against about 6% for random letters
+const char *const ENGLISH_COMMON_BIGRAMS[] = {
+    "TH", "HE", "IN", "ER", "AN", "RE", "ND", "AT", "ON", "NT", "HA", "ES", "ST", "EN", "ED", "TO", "IT", "OU",
+    "EA", "HI", "IS", "OR", "TI", "AS", "TE", "ET", "NG", "OF", "AL", "DE", "SE", "LE", "SA", "SI", "AR", "VE",
+    "RA", "LD", "UR"
+};
+
+struct CommonBigramTable {
+    bool common[26][26] = {};
+
+    CommonBigramTable() {
+        for (const char *bigram : ENGLISH_COMMON_BIGRAMS) common[bigram[0] - 'A'][bigram[1] - 'A'] = true;
+    }
+};
+const CommonBigramTable COMMON_BIGRAMS;
+
+// Mean log-likelihood of the residues that row gives mod prime, against logTable
+double scoreRowModPrime(const BlockHistogram &histogram, const array<int,3> &row, int prime, const double *logTable) {
+    double total = 0.0;
+    for (const UniqueBlock &block : histogram.blocks) {
+        const uint8_t *y = block.letters;
+        total += block.count * logTable[(row[0] * y[0] + row[1] * y[1] + row[2] * y[2]) % prime];
+    }
+    return histogram.blockCount ? total / histogram.blockCount : 0.0;
+}
+
+// Scores every candidate row, in parallel over the leading coefficient
+vector<RowCandidate> scoreInverseRows(const BlockHistogram &histogram, ThreadPool &pool) {
+    vector<RowCandidate> rows(ROW_CANDIDATE_COUNT);
+    pool.parallelFor(MOD_26, [&](size_t a) {
+        for (int code = (int)a * 26 * 26; code < (int)(a + 1) * 26 * 26; ++code) {
+            array<int,3> row = rowFromCode(code);
+            rows[code] = { row, scoreRowModPrime(histogram, row, MOD_26, ENGLISH_LOG_FREQUENCIES.logProbability) };
+        }
+    });
+    return rows;
+}
+
+vector<RowCandidate> bestRows(vector<RowCandidate> rows, size_t count) {
+    count = min(count, rows.size());
+    partial_sort(rows.begin(), rows.begin() + count, rows.end(),
+                 [](const RowCandidate &a, const RowCandidate &b) { return a.fitness > b.fitness; });
+    rows.resize(count);
+    return rows;
+}
+
+// Fraction of adjacent letter pairs in the first blockCount blocks' plaintext that are common bigrams
+double commonBigramRate(const uint8_t *cipher, size_t blockCount, const Matrix3x3 &inverseKey) {
+    if (blockCount == 0) return 0.0;
+    size_t hits = 0;
+    int previous = -1;
+    for (size_t b = 0; b < blockCount; ++b) {
+        const uint8_t *y = cipher + 3 * b;
+        for (int r = 0; r < 3; ++r) {
+            int letter = (inverseKey[r][0] * y[0] + inverseKey[r][1] * y[1] + inverseKey[r][2] * y[2]) % MOD_26;
+            if (previous >= 0) hits += COMMON_BIGRAMS.common[previous][letter];
+            previous = letter;
+        }
+    }
+    return (double)hits / (3 * blockCount - 1);
+}
+
+// CRT-split row search: a row's residues mod 13 and mod 2 decide the plaintext letters' residues
+// mod 13 and mod 2, so the 13^3 mod-13 rows are scored against the folded distribution
+// P(x) + P(x + 13) and the 8 mod-2 rows against letter parity. Only the best mod-13 rows, each
+// combined with every mod-2 row through combineResiduesMod26, are rescored as full rows. The
+// folded score is noisier than the full one, so MOD_13_ROW_OVERSAMPLING times as many mod-13 rows
+// are kept as full rows are wanted: 13^3 + 8 + 64 * count row sweeps instead of 26^3.
+const int ROW_CANDIDATE_COUNT_MOD_13 = 13 * 13 * 13;
+const int ROW_CANDIDATE_COUNT_MOD_2 = 2 * 2 * 2;
+const size_t MOD_13_ROW_OVERSAMPLING = 8;
+
+struct FoldedLogFrequencies {
+    double mod13[13];
+    double mod2[2];
+
+    FoldedLogFrequencies() {
+        double parity[2] = {};
+        for (int i = 0; i < 26; ++i) parity[i % 2] += ENGLISH_LETTER_FREQUENCIES[i] / 100.0;
+        for (int v = 0; v < 13; ++v)
+            mod13[v] = log((ENGLISH_LETTER_FREQUENCIES[v] + ENGLISH_LETTER_FREQUENCIES[v + 13]) / 100.0);
+        for (int v = 0; v < 2; ++v) mod2[v] = log(parity[v]);
+    }
+};
+const FoldedLogFrequencies FOLDED_LOG_FREQUENCIES;
+
+vector<RowCandidate> searchRowsCrt(const BlockHistogram &histogram, size_t count, ThreadPool &pool) {
+    BlockHistogram histogramMod13 = foldBlockHistogram(histogram, MOD_13);
+    BlockHistogram histogramMod2 = foldBlockHistogram(histogram, MOD_2);
+    vector<RowCandidate> rowsMod13(ROW_CANDIDATE_COUNT_MOD_13), rowsMod2(ROW_CANDIDATE_COUNT_MOD_2);
+    pool.parallelFor(MOD_13, [&](size_t a) {
+        for (int code = (int)a * 13 * 13; code < (int)(a + 1) * 13 * 13; ++code) {
+            array<int,3> row = { code / (13 * 13), code / 13 % 13, code % 13 };
+            rowsMod13[code] = { row, scoreRowModPrime(histogramMod13, row, MOD_13, FOLDED_LOG_FREQUENCIES.mod13) };
+        }
+    });
+    for (int code = 0; code < ROW_CANDIDATE_COUNT_MOD_2; ++code) {
+        array<int,3> row = { code >> 2 & 1, code >> 1 & 1, code & 1 };
+        rowsMod2[code] = { row, scoreRowModPrime(histogramMod2, row, MOD_2, FOLDED_LOG_FREQUENCIES.mod2) };
+    }
+
+    vector<RowCandidate> best13 = bestRows(rowsMod13, MOD_13_ROW_OVERSAMPLING * count);
+    vector<RowCandidate> combined(best13.size() * ROW_CANDIDATE_COUNT_MOD_2);
+    pool.parallelFor(combined.size(), [&](size_t i) {
+        const array<int,3> &r13 = best13[i / ROW_CANDIDATE_COUNT_MOD_2].row, &r2 = rowsMod2[i % ROW_CANDIDATE_COUNT_MOD_2].row;
+        array<int,3> row;
+        for (int c = 0; c < 3; ++c) row[c] = combineResiduesMod26(r2[c], r13[c]);
+        combined[i] = { row, scoreRowModPrime(histogram, row, MOD_26, ENGLISH_LOG_FREQUENCIES.logProbability) };
+    });
+    return bestRows(combined, count);
+}
+
+// Every ordered triple of distinct rows that forms an invertible inverse key, ranked by the mean
+// unigram fitness of its rows plus BIGRAM_WEIGHT times its common-bigram rate on the message
+// prefix (bigrams depend on block order, so this one score cannot use the histogram)
+vector<RankedKey> assembleRowKeys(const vector<RowCandidate> &rows, const vector<uint8_t> &prefix, ThreadPool &pool) {
+    size_t n = rows.size(), prefixBlocks = prefix.size() / 3;
+    vector<vector<RankedKey>> perFirstRow(n);
+    pool.parallelFor(n, [&](size_t i) {
+        for (size_t j = 0; j < n; ++j)
+            for (size_t k = 0; k < n; ++k) {
+                if (i == j || j == k || i == k) continue;
+                RankedKey candidate;
+                candidate.inverse = { rows[i].row, rows[j].row, rows[k].row };
+                if (!tryInvertKeyMatrixMod26(candidate.inverse, candidate.key)) continue;
+                candidate.fitness = (rows[i].fitness + rows[j].fitness + rows[k].fitness) / 3
+                                    + BIGRAM_WEIGHT * commonBigramRate(prefix.data(), prefixBlocks, candidate.inverse);
+                perFirstRow[i].push_back(candidate);
+            }
+    });
+    vector<RankedKey> ranked;
+    for (vector<RankedKey> &keys : perFirstRow) ranked.insert(ranked.end(), keys.begin(), keys.end());
+    sort(ranked.begin(), ranked.end(), [](const RankedKey &a, const RankedKey &b) { return a.fitness > b.fitness; });
+    return ranked;
+}
+
+// ---------- Quadgram language model ----------
+// Log-probabilities of the 26^4 letter quadgrams, quantized to int16 (QUADGRAM_SCALE units per
+// natural-log unit) so the whole table (under 1 MB) stays cache-resident. Quadgrams never seen in
+// the corpus get the probability of QUADGRAM_FLOOR_COUNT occurrences.
+//
+// Binary file (native little-endian): a 16-byte QuadgramFileHeader, the 26^4 int16 scores, then
+// QUADGRAM_PADDING_ENTRIES zero entries. Loading maps the file read-only; there is nothing to parse.
+const double QUADGRAM_SCALE = 100.0;
+const double QUADGRAM_FLOOR_COUNT = 0.01;
+const char QUADGRAM_FILE_MAGIC[4] = { 'H', 'Q', 'G', '1' };
+
+struct QuadgramFileHeader {
+    char magic[4];
+    uint32_t entryCount;
+    float scale;
+    int16_t floorScore;     // score given to unseen quadgrams
+    uint16_t reserved;
+};
+static_assert(sizeof(QuadgramFileHeader) == 16, "quadgram file header must be 16 bytes");
+
+class QuadgramModel {
+public:
+    // Counts quadgrams of the corpus letters, ignoring every other byte
+    static QuadgramModel fromCorpus(istream &corpus) {
+        vector<uint64_t> counts(QUADGRAM_COUNT);
+        uint64_t total = 0;
+        int code = 0, length = 0;
+        vector<char> chunk(DEFAULT_STREAM_CHUNK_SIZE);
+        while (corpus.read(chunk.data(), chunk.size()) || corpus.gcount() > 0) {
+            for (streamsize k = 0; k < corpus.gcount(); ++k) {
+                uint8_t index = LETTER_INDEX_TABLE[chunk[k]];
+                if (index == NOT_A_LETTER) continue;
+                code = code % TRIGRAM_COUNT * 26 + index;
+                if (++length >= 4) {
+                    ++counts[code];
+                    ++total;
+                }
+            }
+        }
+        if (total == 0) throw runtime_error("Corpus contains no quadgrams.");
+
+        auto table = make_shared<vector<int16_t>>(QUADGRAM_COUNT + QUADGRAM_PADDING_ENTRIES);
+        auto quantize = [&](double count) { return (int16_t)max(-32768.0, round(QUADGRAM_SCALE * log(count / total))); };
+        for (int i = 0; i < QUADGRAM_COUNT; ++i) (*table)[i] = quantize(counts[i] ? counts[i] : QUADGRAM_FLOOR_COUNT);
+        QuadgramModel model;
+        model.floorScore = quantize(QUADGRAM_FLOOR_COUNT);
+        model.table = table->data();
+        model.storage = table;
+        return model;
+    }
+
+    static QuadgramModel load(const string &path) {
+        size_t fileSize = sizeof(QuadgramFileHeader) + sizeof(int16_t) * (QUADGRAM_COUNT + QUADGRAM_PADDING_ENTRIES);
+        QuadgramModel model;
+#ifdef HILL_HAVE_MMAP
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Cannot open quadgram file: " + path);
+        struct stat info;
+        bool sizeOk = fstat(fd, &info) == 0 && (size_t)info.st_size >= fileSize;
+        void *mapped = sizeOk ? mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mapped == MAP_FAILED) throw runtime_error("Cannot map quadgram file: " + path);
+        model.storage = shared_ptr<const void>(mapped, [fileSize](const void *p) { munmap((void *)p, fileSize); });
+        const char *bytes = (const char *)mapped;
+#else
+        ifstream file(path, ios::binary);
+        auto contents = make_shared<vector<char>>(fileSize);
+        if (!file.read(contents->data(), fileSize)) throw runtime_error("Cannot read quadgram file: " + path);
+        model.storage = contents;
+        const char *bytes = contents->data();
+#endif
+        QuadgramFileHeader header;
+        memcpy(&header, bytes, sizeof(header));
+        if (memcmp(header.magic, QUADGRAM_FILE_MAGIC, 4) != 0 || header.entryCount != (uint32_t)QUADGRAM_COUNT
+            || header.scale != (float)QUADGRAM_SCALE)
+            throw runtime_error("Not a quadgram model file: " + path);
+        model.floorScore = header.floorScore;
+        model.table = (const int16_t *)(bytes + sizeof(QuadgramFileHeader));
+        return model;
+    }
+
+    void save(const string &path) const {
+        ofstream file(path, ios::binary);
+        if (!file) throw runtime_error("Cannot open output file: " + path);
+        QuadgramFileHeader header{};
+        memcpy(header.magic, QUADGRAM_FILE_MAGIC, 4);
+        header.entryCount = QUADGRAM_COUNT;
+        header.scale = (float)QUADGRAM_SCALE;
+        header.floorScore = floorScore;
+        vector<int16_t> padding(QUADGRAM_PADDING_ENTRIES);
+        file.write((const char *)&header, sizeof(header));
+        file.write((const char *)table, sizeof(int16_t) * QUADGRAM_COUNT);
+        file.write((const char *)padding.data(), sizeof(int16_t) * padding.size());
+        if (!file) throw runtime_error("Failed to write " + path);
+    }
+
+    const int16_t *scores() const { return table; }
+
+    // Sum of the quadgram scores of a letter-index sequence, through the active kernel
+    int64_t scoreLetters(const uint8_t *letters, size_t size) const {
+        return activeDecryptKernel().scoreQuadgrams(table, letters, size);
+    }
+
+    // Same for uppercase plaintext such as decryptCiphertextWithKeyInverse returns
+    int64_t scorePlaintext(const string &plaintext) const {
+        vector<uint8_t> letters(plaintext.size());
+        for (size_t i = 0; i < plaintext.size(); ++i) letters[i] = (uint8_t)(plaintext[i] - 'A');
+        return scoreLetters(letters.data(), letters.size());
+    }
+
+private:
+    shared_ptr<const void> storage;     // owns the table: heap vector or file mapping
+    const int16_t *table = nullptr;
+    int16_t floorScore = 0;
+};
+
+// ---------- Simulated annealing attack ----------
+// Searches inverse keys directly. A move changes one entry M[r][c] by d, which changes only
+// plaintext letter r of every block, by d * c_c: the plaintext is updated in place with one
+// multiply-add per block instead of being decrypted again. Every quadgram spans all three block
+// positions, though, so no quadgram keeps its score and the sum is recomputed over the scored
+// prefix after each move. One move in ANNEAL_ROW_SWAP_ODDS swaps two rows of the inverse instead,
+// which leaves the block-rotated plaintexts that otherwise trap the search. A restart that beats
+// the global best is polished row by row (polishRows).
+// Restarts run on every pool thread with their own RNG; half of them start from the shared global
+// best with a few entries perturbed, the rest from a random matrix.
+const size_t ANNEAL_MAX_BLOCKS = 1000;
+const int ANNEAL_STEPS_PER_RESTART = 10000;
+const double ANNEAL_START_TEMPERATURE = 10.0 * QUADGRAM_SCALE;   // per 100 scored letters
+const int ANNEAL_RESTART_PERTURBATIONS = 2;
+const int ANNEAL_ROW_SWAP_ODDS = 16;        // one move in this many swaps two rows of the inverse
+const size_t ANNEAL_POLISH_BLOCKS = 200;
+
+struct AnnealSettings {
+    double seconds = 10.0;      // wall-clock budget
+    size_t maxRestarts = 0;     // 0 = until the budget runs out
+    uint64_t seed = 1;
+};
+
+struct AnnealBest {
+    mutex bestMutex;
+    bool found = false;
+    int64_t score = 0;
+    Matrix3x3 inverse{};
+    atomic<uint64_t> restarts{0};
+};
+
+// One annealing run from inverse (updated to the best matrix it visits); returns that matrix's score
+int64_t annealRestart(const uint8_t *cipher, size_t blockCount, const QuadgramModel &model, Matrix3x3 &inverse,
+                      mt19937_64 &rng, vector<uint8_t> &plain) {
+    size_t letterCount = 3 * blockCount;
+    plain.resize(letterCount);
+    for (size_t b = 0; b < blockCount; ++b) {
+        const uint8_t *y = cipher + 3 * b;
+        for (int r = 0; r < 3; ++r)
+            plain[3 * b + r] = (uint8_t)((inverse[r][0] * y[0] + inverse[r][1] * y[1] + inverse[r][2] * y[2]) % MOD_26);
+    }
+    auto shiftLetters = [&](int r, int c, int d) {
+        for (size_t b = 0; b < blockCount; ++b) {
+            uint8_t &letter = plain[3 * b + r];
+            letter = (uint8_t)((letter + d * cipher[3 * b + c]) % MOD_26);
+        }
+    };
+    auto swapLetters = [&](int r, int other) {
+        for (size_t b = 0; b < blockCount; ++b) swap(plain[3 * b + r], plain[3 * b + other]);
+    };
+
+    int64_t current = model.scoreLetters(plain.data(), letterCount), best = current;
+    Matrix3x3 bestInverse = inverse;
+    double startTemperature = ANNEAL_START_TEMPERATURE * letterCount / 100.0;
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (int step = 0; step < ANNEAL_STEPS_PER_RESTART; ++step) {
+        double temperature = startTemperature * (1.0 - (double)step / ANNEAL_STEPS_PER_RESTART);
+        int r = (int)(rng() % 3), c = (int)(rng() % 3), d = 1 + (int)(rng() % 25);
+        bool swapMove = rng() % ANNEAL_ROW_SWAP_ODDS == 0;
+        int other = (r + 1 + c % 2) % 3;
+        if (swapMove) swapLetters(r, other);
+        else shiftLetters(r, c, d);
+        int64_t candidate = model.scoreLetters(plain.data(), letterCount);
+        int64_t delta = candidate - current;
+        if (delta >= 0 || (temperature > 0 && uniform(rng) < exp(delta / temperature))) {
+            current = candidate;
+            if (swapMove) swap(inverse[r], inverse[other]);
+            else inverse[r][c] = (inverse[r][c] + d) % MOD_26;
+            if (current > best) {
+                best = current;
+                bestInverse = inverse;
+            }
+        } else if (swapMove) {
+            swapLetters(r, other);
+        } else {
+            shiftLetters(r, c, MOD_26 - d);
+        }
+    }
+    inverse = bestInverse;
+    return best;
+}
+
+// Exhaustive search of each inverse row in turn with the other two fixed, scored over the first
+// ANNEAL_POLISH_BLOCKS blocks, repeated until no row changes. Annealing often gets two rows right
+// and leaves the third in a local optimum that single-entry moves cannot leave. Returns the
+// score of the polished inverse over all blockCount blocks.
+int64_t polishRows(const uint8_t *cipher, size_t blockCount, const QuadgramModel &model, Matrix3x3 &inverse,
+                   vector<uint8_t> &plain) {
+    size_t polishBlocks = min(blockCount, ANNEAL_POLISH_BLOCKS);
+    auto decryptLane = [&](int r, size_t count) {
+        for (size_t b = 0; b < count; ++b) {
+            const uint8_t *y = cipher + 3 * b;
+            plain[3 * b + r] = (uint8_t)((inverse[r][0] * y[0] + inverse[r][1] * y[1] + inverse[r][2] * y[2]) % MOD_26);
+        }
+    };
+    plain.resize(3 * blockCount);
+    for (int r = 0; r < 3; ++r) decryptLane(r, polishBlocks);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int r = 0; r < 3; ++r) {
+            array<int, 3> bestRow = inverse[r];
+            int64_t bestScore = model.scoreLetters(plain.data(), 3 * polishBlocks);
+            for (int code = 0; code < TRIGRAM_COUNT; ++code) {
+                inverse[r] = {code / 676, code / 26 % 26, code % 26};
+                decryptLane(r, polishBlocks);
+                int64_t score = model.scoreLetters(plain.data(), 3 * polishBlocks);
+                if (score > bestScore) {
+                    bestScore = score;
+                    changed = true;
+                    bestRow = inverse[r];
+                }
+            }
+            inverse[r] = bestRow;
+            decryptLane(r, polishBlocks);
+        }
+    }
+    for (int r = 0; r < 3; ++r) decryptLane(r, blockCount);
+    return model.scoreLetters(plain.data(), 3 * blockCount);
+}
+
+// Runs restarts on every pool thread until the budget is spent; progress lines go to telemetry
+void annealSearch(const vector<uint8_t> &cipher, const QuadgramModel &model, const AnnealSettings &settings,
+                  ThreadPool &pool, AnnealBest &best, ostream &telemetry) {
+    size_t blockCount = min(cipher.size() / 3, ANNEAL_MAX_BLOCKS);
+    size_t quadgramCount = 3 * blockCount > 3 ? 3 * blockCount - 3 : 1;
+    auto startTime = chrono::steady_clock::now();
+    auto elapsed = [&] { return chrono::duration<double>(chrono::steady_clock::now() - startTime).count(); };
+
+    pool.parallelFor(pool.size(), [&](size_t thread) {
+        mt19937_64 rng(settings.seed * 0x9E3779B97F4A7C15ULL + thread);
+        vector<uint8_t> plain;
+        while (elapsed() < settings.seconds) {
+            // claim a restart number, never counting past maxRestarts
+            uint64_t restart = best.restarts.load();
+            do {
+                if (settings.maxRestarts && restart >= settings.maxRestarts) return;
+            } while (!best.restarts.compare_exchange_weak(restart, restart + 1));
+
+            Matrix3x3 inverse;
+            bool fromBest = false;
+            if (rng() % 2) {
+                lock_guard<mutex> lock(best.bestMutex);
+                fromBest = best.found;
+                inverse = best.inverse;
+            }
+            if (fromBest) {
+                for (int p = 0; p < ANNEAL_RESTART_PERTURBATIONS; ++p) inverse[rng() % 3][rng() % 3] = (int)(rng() % MOD_26);
+            } else {
+                for (auto &row : inverse)
+                    for (int &entry : row) entry = (int)(rng() % MOD_26);
+            }
+
+            int64_t score = annealRestart(cipher.data(), blockCount, model, inverse, rng, plain);
+            bool promising;
+            {
+                lock_guard<mutex> lock(best.bestMutex);
+                promising = !best.found || score > best.score;
+            }
+            if (promising) score = polishRows(cipher.data(), blockCount, model, inverse, plain);
+            Matrix3x3 key;
+            if (!tryInvertKeyMatrixMod26(inverse, key)) continue;
+            lock_guard<mutex> lock(best.bestMutex);
+            if (best.found && score <= best.score) continue;
+            best.found = true;
+            best.score = score;
+            best.inverse = inverse;
+            telemetry << fixed << setprecision(2) << "[" << elapsed() << " s] restart " << restart << ": score "
+                      << setprecision(3) << score / QUADGRAM_SCALE / quadgramCount << " per quadgram, key "
+                      << matrixToKeyString(key) << "\n";
+        }
+    });
+}
+
+// ---------- Sequential candidate scoring ----------
+// Scores a candidate inverse key chunk by chunk and stops as soon as it clearly cannot reach the
+// current top-K threshold. Chunk means are treated as samples: after k of them with mean m and
+// standard deviation s, the candidate is rejected when m + z * s / sqrt(k) < threshold, z being
+// the upper normal quantile of the configured false-reject rate. Wrong keys score so far below
+// English that they are almost always dropped after the first SEQUENTIAL_MIN_CHUNKS chunks.
+const size_t SEQUENTIAL_CHUNK_BLOCKS = 32;
+const size_t SEQUENTIAL_MIN_CHUNKS = 4;
+const double DEFAULT_FALSE_REJECT_RATE = 0.001;
+
+// z with P(Z > z) = alpha for a standard normal Z
+double normalUpperQuantile(double alpha) {
+    double low = -10.0, high = 10.0;
+    for (int i = 0; i < 100; ++i) {
+        double mid = (low + high) / 2;
+        if (0.5 * erfc(mid / sqrt(2.0)) > alpha) low = mid;
+        else high = mid;
+    }
+    return (low + high) / 2;
+}
+
+// Per-quadgram score of the K-th best fully scored candidate (-infinity until K have been seen)
+class TopKThreshold {
+public:
+    explicit TopKThreshold(size_t k) : k(max<size_t>(1, k)) {}
+
+    double current() const { return threshold.load(memory_order_relaxed); }
+
+    void offer(double score) {
+        lock_guard<mutex> lock(topMutex);
+        if (best.size() < k) best.push(score);
+        else if (score > best.top()) {
+            best.pop();
+            best.push(score);
+        }
+        if (best.size() == k) threshold.store(best.top(), memory_order_relaxed);
+    }
+
+private:
+    size_t k;
+    mutex topMutex;
+    priority_queue<double, vector<double>, greater<double>> best;
+    atomic<double> threshold{-numeric_limits<double>::infinity()};
+};
+
+struct SequentialScore {
+    double meanScore = 0.0;     // quadgram score per quadgram (natural log) over the evaluated blocks
+    size_t blocksEvaluated = 0;
+    bool rejected = false;
+};
+
+// Running chunk statistics of one candidate. The letter buffer keeps three letters of the previous
+// chunk in front of the current one, so quadgrams spanning chunk boundaries are counted once.
+class SequentialAccumulator {
+public:
+    // Room for the carried letters plus one chunk; fill it from chunkLetters()
+    uint8_t *chunkLetters() { return letters + carried; }
+
+    // Scores the chunkLetterCount letters written to chunkLetters() and carries the last three
+    void addChunk(size_t chunkLetterCount, const QuadgramModel &model) {
+        size_t letterCount = carried + chunkLetterCount;
+        if (letterCount >= 4) {
+            double chunkScore = model.scoreLetters(letters, letterCount) / QUADGRAM_SCALE;
+            size_t chunkQuadgrams = letterCount - 3;
+            double chunkMean = chunkScore / chunkQuadgrams;
+            total += chunkScore;
+            quadgrams += chunkQuadgrams;
+            sum += chunkMean;
+            sumSquares += chunkMean * chunkMean;
+            ++chunks;
+        }
+        memmove(letters, letters + letterCount - 3, 3);
+        carried = 3;
+    }
+
+    bool shouldReject(double z, double limit) const {
+        if (chunks < SEQUENTIAL_MIN_CHUNKS || limit == -numeric_limits<double>::infinity()) return false;
+        double mean = sum / chunks;
+        double deviation = sqrt(max(0.0, (sumSquares - chunks * mean * mean) / (chunks - 1)));
+        return mean + z * deviation / sqrt((double)chunks) < limit;
+    }
+
+    double meanScore() const { return quadgrams ? total / quadgrams : 0.0; }
+
+private:
+    uint8_t letters[3 + 3 * SEQUENTIAL_CHUNK_BLOCKS];
+    double sum = 0.0, sumSquares = 0.0, total = 0.0;
+    size_t chunks = 0, quadgrams = 0, carried = 0;
+};
+
+SequentialScore scoreKeySequential(const uint8_t *cipher, size_t blockCount, const Matrix3x3 &inverse,
+                                   const QuadgramModel &model, double z, const TopKThreshold &threshold) {
+    SequentialScore result;
+    SequentialAccumulator accumulator;
+    for (size_t begin = 0; begin < blockCount; begin += SEQUENTIAL_CHUNK_BLOCKS) {
+        size_t end = min(blockCount, begin + SEQUENTIAL_CHUNK_BLOCKS);
+        uint8_t *out = accumulator.chunkLetters();
+        for (size_t b = begin; b < end; ++b) {
+            const uint8_t *y = cipher + 3 * b;
+            for (int r = 0; r < 3; ++r)
+                *out++ = (uint8_t)((inverse[r][0] * y[0] + inverse[r][1] * y[1] + inverse[r][2] * y[2]) % MOD_26);
+        }
+        accumulator.addChunk(3 * (end - begin), model);
+        result.blocksEvaluated = end;
+        if (accumulator.shouldReject(z, threshold.current())) {
+            result.rejected = true;
+            break;
+        }
+    }
+    result.meanScore = accumulator.meanScore();
+    return result;
+}
+
+// ---------- Tiled multi-key scoring ----------
+// Scoring a key library is a product of the 3K x 3 matrix of stacked inverse keys with the 3 x N
+// matrix of ciphertext block columns. Keys are taken in panels of LIBRARY_PANEL_KEYS and columns
+// in tiles of SEQUENTIAL_CHUNK_BLOCKS: each tile is de-interleaved once into three 16-bit column
+// vectors that stay in L1 while every active key of the panel multiplies them. The 3 x tile
+// product of a key is scored straight away and then overwritten, so no plaintext outlives its
+// tile. Keys leave the panel under the same sequential test as scoreKeySequential().
+const size_t LIBRARY_PANEL_KEYS = 16;
+
+struct CipherTile {
+    alignas(64) uint16_t column[3][SEQUENTIAL_CHUNK_BLOCKS];    // block component j of each block
+    size_t blockCount = 0;
+
+    void load(const uint8_t *cipher, size_t blocks) {
+        blockCount = blocks;
+        for (size_t b = 0; b < SEQUENTIAL_CHUNK_BLOCKS; ++b)
+            for (int j = 0; j < 3; ++j) column[j][b] = b < blocks ? cipher[3 * b + j] : 0;
+    }
+};
+
+// Writes the tile's plaintext letter indices under inverse to out (3 * tile.blockCount letters).
+// Fixed-length loops over the columns, so the compiler keeps them in vector registers.
+void multiplyCipherTile(const CipherTile &tile, const Matrix3x3 &inverse, uint8_t *out) {
+    alignas(64) uint16_t row[3][SEQUENTIAL_CHUNK_BLOCKS];
+    for (int r = 0; r < 3; ++r) {
+        uint16_t k0 = (uint16_t)inverse[r][0], k1 = (uint16_t)inverse[r][1], k2 = (uint16_t)inverse[r][2];
+        for (size_t b = 0; b < SEQUENTIAL_CHUNK_BLOCKS; ++b) {
+            uint16_t sum = (uint16_t)(k0 * tile.column[0][b] + k1 * tile.column[1][b] + k2 * tile.column[2][b]);
+            row[r][b] = (uint16_t)(sum - 26 * ((sum * 2521u) >> 16));     // sum % 26 for sum < 6553
+        }
+    }
+    for (size_t b = 0; b < tile.blockCount; ++b)
+        for (int r = 0; r < 3; ++r) out[3 * b + r] = (uint8_t)row[r][b];
+}
+
+// Scores inverses[keyIndices[0..count)] over cipher (letter indices); scores[k] belongs to keyIndices[k]
+void scoreKeyPanelTiled(const uint8_t *cipher, size_t blockCount, const Matrix3x3 *inverses,
+                        const size_t *keyIndices, size_t count, const QuadgramModel &model, double z,
+                        const TopKThreshold &threshold, SequentialScore *scores) {
+    vector<SequentialAccumulator> accumulators(count);
+    vector<size_t> active(count);
+    iota(active.begin(), active.end(), (size_t)0);
+    CipherTile tile;
+    for (size_t begin = 0; begin < blockCount && !active.empty(); begin += SEQUENTIAL_CHUNK_BLOCKS) {
+        tile.load(cipher + 3 * begin, min(blockCount - begin, SEQUENTIAL_CHUNK_BLOCKS));
+        double limit = threshold.current();
+        size_t kept = 0;
+        for (size_t k : active) {
+            multiplyCipherTile(tile, inverses[keyIndices[k]], accumulators[k].chunkLetters());
+            accumulators[k].addChunk(3 * tile.blockCount, model);
+            scores[k].blocksEvaluated = begin + tile.blockCount;
+            if (accumulators[k].shouldReject(z, limit)) scores[k].rejected = true;
+            else active[kept++] = k;
+        }
+        active.resize(kept);
+    }
+    for (size_t k = 0; k < count; ++k) scores[k].meanScore = accumulators[k].meanScore();
+}
+
+// ---------- Command-line options ----------
+enum class RunMode {
+    Interactive, Stream, Mmap, ListKernels, InvertKeys, BenchInvert, KeyedMessages, KnownPlaintext, CribDrag,
+    AttackRows, Anneal, BuildQuadgrams, KeyLibrary, EnumerateKeys, GraySweep, InvertLarge, SelfCheck
+};
+
+struct CommandLineOptions {
+    RunMode mode = RunMode::Interactive;  // no arguments: prompt for key and ciphertext
+    bool hugePages = false;     // --huge-pages
+    string keyString;           // --key KEY
+    string inputPath;           // --input FILE (default: stdin)
+    string outputPath;          // --output FILE (default: stdout)
+    size_t chunkSize = DEFAULT_STREAM_CHUNK_SIZE;  // --chunk-size BYTES
+    int blockSize = 3;                             // --block-size N (--stream)
+    string alphabetName = "letters";               // --alphabet letters|alnum|printable|bytes|SYMBOLS (--stream)
+    DecodeEngine engine = DecodeEngine::Auto;      // --engine auto|kernel|table|fused
+    unsigned threadCount = 1;                      // --threads N (0 = all cores)
+    size_t benchCount = 0;                         // --bench-invert COUNT
+    size_t largeKeySize = 0;                       // --invert-large N
+    size_t cacheBytes = DEFAULT_KEY_CACHE_BYTES;   // --cache-bytes BYTES
+    string crib;                                   // --known-plaintext / --crib-drag CRIB
+    size_t topCount = 10;                          // --top N
+    size_t topRows = 24;                           // --top-rows K
+    bool fullRowSearch = false;                    // --row-search full|crt
+    bool perKeyLibraryScan = false;                // --library-scan per-key|tiled
+    bool batch = false;                            // --batch (one ciphertext per input line)
+    string corpusPath;                             // --corpus FILE (--build-quadgrams CORPUS OUT)
+    string quadgramPath;                           // --quadgrams FILE
+    string keyLibraryPath;                         // --key-library FILE
+    double falseRejectRate = DEFAULT_FALSE_REJECT_RATE;  // --false-reject-rate P
+    uint64_t rangeStart = 0, rangeCount = 0;       // --enumerate-keys / --gray-sweep START COUNT
+    AnnealSettings anneal;                         // --seconds S, --restarts N, --seed N
+    size_t cribOffset = 0;                         // --crib-offset LETTERS
+};
+
+void printUsage(ostream &os, const char *programName) {
+    os << "Usage:\n"
+       << "  " << programName << "                      interactive mode\n"
+       << "  " << programName << " --stream --key KEY [--input FILE] [--output FILE] [--chunk-size BYTES] [--block-size N]\n"
+       << "                [--alphabet letters|alnum|printable|bytes|SYMBOLS]\n"
+       << "      decrypt a stream of any size in constant memory (N x N keys of N*N letters, N = 2..8;\n"
+       << "      other alphabets work mod their size)\n"
+       << "  " << programName << " --mmap --key KEY --input FILE --output FILE [--huge-pages]\n"
+       << "      file-to-file decryption through memory-mapped I/O, reports throughput\n"
+       << "  " << programName << " --list-kernels\n"
+       << "      show the SIMD kernels and which ones this CPU supports\n"
+       << "  " << programName << " --invert-keys [--input FILE] [--output FILE]\n"
+       << "      batch-invert one 9-letter key per line (prints the inverse key or '-')\n"
+       << "  " << programName << " --bench-invert COUNT [--threads N]\n"
+       << "      time batch inversion of COUNT random keys\n"
+       << "  " << programName << " --invert-large N [--input FILE] [--output FILE] [--threads N]\n"
+       << "      invert one N x N key (N*N letters, row-major) by elimination mod 2 and mod 13\n"
+       << "  " << programName << " --keyed-messages [--input FILE] [--output FILE] [--cache-bytes BYTES]\n"
+       << "      decrypt 'KEY<TAB>ciphertext' lines through the inverse-key cache\n"
+       << "  " << programName << " --known-plaintext CRIB [--crib-offset N] [--input FILE]\n"
+       << "      recover the key from known plaintext starting at ciphertext letter N (default 0)\n"
+       << "      and print the --top N (default 10) consistent keys ranked by English fitness\n"
+       << "  " << programName << " --crib-drag CRIB [--input FILE] [--threads N] [--top N]\n"
+       << "      slide the crib over every ciphertext offset and rank the keys it yields\n"
+       << "  " << programName << " --attack-rows [--input FILE] [--top-rows K] [--top N] [--row-search crt|full] [--batch]\n"
+       << "      ciphertext-only attack: score inverse-key rows, combine the best K\n"
+       << "      (crt = search mod 13 and mod 2 separately; --batch = one ciphertext per line)\n"
+       << "  " << programName << " --anneal --corpus FILE|--quadgrams FILE [--input FILE] [--seconds S] [--restarts N] [--seed N]\n"
+       << "      simulated-annealing key search scored by quadgrams, restarts on every thread\n"
+       << "  " << programName << " --build-quadgrams CORPUS OUT\n"
+       << "      write the quadgram model of a text corpus as a binary file for --quadgrams\n"
+       << "  " << programName << " --key-library KEYS --quadgrams FILE [--input FILE] [--top N] [--false-reject-rate P]\n"
+       << "                [--library-scan tiled|per-key]\n"
+       << "      rank candidate keys (one per line) on the ciphertext, abandoning hopeless ones early\n"
+       << "      (tiled = key panels share each ciphertext tile; per-key = one pass per key)\n"
+       << "  " << programName << " --enumerate-keys START COUNT [--output FILE] [--threads N]\n"
+       << "      print invertible keys START..START+COUNT-1 of GL(3,Z26) with their inverses\n"
+       << "  " << programName << " --gray-sweep START COUNT [--threads N]\n"
+       << "      sweep raw key indices in Gray-code order with incremental determinants, report keys/s\n"
+       << "  " << programName << " --self-check\n"
+       << "      cross-check the fast paths against reference implementations on seeded inputs\n"
+       << "Options:\n"
+       << "  --engine auto|kernel|table|fused\n"
+       << "                               block decoder (table = per-key 26^3 trigram lookup table,\n"
+       << "                               fused = single pass from raw bytes to plaintext)\n"
+       << "  --threads N                  decrypt chunks on N threads (0 = all cores)\n"
+       << "  --kernel NAME                force a SIMD kernel (default: best supported by this CPU)\n";
+}
+
+CommandLineOptions parseCommandLine(int argc, char **argv) {
+    CommandLineOptions options;
+    auto requireValue = [&](int &i) -> string {
+        if (i + 1 >= argc) throw runtime_error(string("Missing value for ") + argv[i] + ".");
+        return argv[++i];
+    };
+    bool modeSelected = false;
+    auto selectMode = [&](RunMode mode) {
+        if (modeSelected) throw runtime_error("Select only one mode.");
+        modeSelected = true;
+        options.mode = mode;
+    };
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--stream") selectMode(RunMode::Stream);
+        else if (arg == "--mmap") selectMode(RunMode::Mmap);
+        else if (arg == "--list-kernels") selectMode(RunMode::ListKernels);
+        else if (arg == "--self-check") selectMode(RunMode::SelfCheck);
+        else if (arg == "--invert-keys") selectMode(RunMode::InvertKeys);
+        else if (arg == "--bench-invert") {
+            selectMode(RunMode::BenchInvert);
+            options.benchCount = (size_t)stoull(requireValue(i));
+        }
+        else if (arg == "--invert-large") {
+            selectMode(RunMode::InvertLarge);
+            options.largeKeySize = (size_t)stoull(requireValue(i));
+            if (options.largeKeySize == 0) throw runtime_error("--invert-large needs a positive block size.");
+        }
+        else if (arg == "--keyed-messages") selectMode(RunMode::KeyedMessages);
+        else if (arg == "--cache-bytes") options.cacheBytes = (size_t)stoull(requireValue(i));
+        else if (arg == "--known-plaintext") {
+            selectMode(RunMode::KnownPlaintext);
+            options.crib = requireValue(i);
+        }
+        else if (arg == "--crib-drag") {
+            selectMode(RunMode::CribDrag);
+            options.crib = requireValue(i);
+        }
+        else if (arg == "--attack-rows") selectMode(RunMode::AttackRows);
+        else if (arg == "--row-search") {
+            string search = requireValue(i);
+            if (search != "crt" && search != "full") throw runtime_error("Unknown row search: " + search);
+            options.fullRowSearch = search == "full";
+        }
+        else if (arg == "--anneal") selectMode(RunMode::Anneal);
+        else if (arg == "--corpus") options.corpusPath = requireValue(i);
+        else if (arg == "--quadgrams") options.quadgramPath = requireValue(i);
+        else if (arg == "--build-quadgrams") {
+            selectMode(RunMode::BuildQuadgrams);
+            options.corpusPath = requireValue(i);
+            options.outputPath = requireValue(i);
+        }
+        else if (arg == "--seconds") options.anneal.seconds = stod(requireValue(i));
+        else if (arg == "--restarts") options.anneal.maxRestarts = (size_t)stoull(requireValue(i));
+        else if (arg == "--seed") options.anneal.seed = stoull(requireValue(i));
+        else if (arg == "--key-library") {
+            selectMode(RunMode::KeyLibrary);
+            options.keyLibraryPath = requireValue(i);
+        }
+        else if (arg == "--library-scan") {
+            string scan = requireValue(i);
+            if (scan != "tiled" && scan != "per-key") throw runtime_error("Unknown library scan: " + scan);
+            options.perKeyLibraryScan = scan == "per-key";
+        }
+        else if (arg == "--false-reject-rate") {
+            options.falseRejectRate = stod(requireValue(i));
+            if (!(options.falseRejectRate > 0 && options.falseRejectRate < 0.5))
+                throw runtime_error("--false-reject-rate must be between 0 and 0.5.");
+        }
+        else if (arg == "--enumerate-keys") {
+            selectMode(RunMode::EnumerateKeys);
+            options.rangeStart = stoull(requireValue(i));
+            options.rangeCount = stoull(requireValue(i));
+        }
+        else if (arg == "--gray-sweep") {
+            selectMode(RunMode::GraySweep);
+            options.rangeStart = stoull(requireValue(i));
+            options.rangeCount = stoull(requireValue(i));
+        }
+        else if (arg == "--batch") options.batch = true;
+        else if (arg == "--top-rows") options.topRows = (size_t)stoull(requireValue(i));
+        else if (arg == "--top") options.topCount = (size_t)stoull(requireValue(i));
+        else if (arg == "--crib-offset") options.cribOffset = (size_t)stoull(requireValue(i));
+        else if (arg == "--huge-pages") options.hugePages = true;
+        else if (arg == "--key") options.keyString = requireValue(i);
+        else if (arg == "--engine") options.engine = parseDecodeEngine(requireValue(i));
+        else if (arg == "--threads") options.threadCount = resolveThreadCount((unsigned)stoul(requireValue(i)));
+        else if (arg == "--kernel") selectDecryptKernel(requireValue(i));
+        else if (arg == "--input") options.inputPath = requireValue(i);
+        else if (arg == "--output") options.outputPath = requireValue(i);
+        else if (arg == "--block-size") {
+            options.blockSize = stoi(requireValue(i));
+            if (options.blockSize < HILL_MIN_BLOCK_SIZE || options.blockSize > HILL_MAX_BLOCK_SIZE)
+                throw runtime_error("--block-size must be between " + to_string(HILL_MIN_BLOCK_SIZE) + " and "
+                                    + to_string(HILL_MAX_BLOCK_SIZE) + ".");
+        }
+        else if (arg == "--alphabet") options.alphabetName = requireValue(i);
+        else if (arg == "--chunk-size") {
+            string value = requireValue(i);
+            options.chunkSize = (size_t)stoull(value);
+            if (options.chunkSize == 0) throw runtime_error("--chunk-size must be positive.");
+        }
+        else throw runtime_error("Unknown option: " + arg);
+    }
+    if (argc > 1 && !modeSelected) throw runtime_error("No mode selected (see --help).");
+    if (options.mode == RunMode::Mmap && (options.inputPath.empty() || options.outputPath.empty()))
+        throw runtime_error("--mmap requires --input and --output files.");
+    if ((options.mode == RunMode::Stream || options.mode == RunMode::Mmap) && options.keyString.empty())
+        throw runtime_error("--key is required for --stream and --mmap.");
+    if ((options.blockSize != 3 || options.alphabetName != "letters") && options.mode != RunMode::Stream)
+        throw runtime_error("--block-size and --alphabet are only supported with --stream.");
+    if (options.mode == RunMode::Anneal && options.corpusPath.empty() == options.quadgramPath.empty())
+        throw runtime_error("--anneal requires either --corpus or --quadgrams.");
+    if (options.mode == RunMode::KeyLibrary && options.quadgramPath.empty())
+        throw runtime_error("--key-library requires --quadgrams.");
+    return options;
+}
+
+// ---------- Mode input/output ----------
+// --input FILE or stdin
+istream &openInputStream(const string &path, ifstream &file) {
+    if (path.empty()) return cin;
+    file.open(path, ios::binary);
+    if (!file) throw runtime_error("Cannot open input file: " + path);
+    return file;
+}
+
+// --output FILE or stdout
+ostream &openOutputStream(const string &path, ofstream &file) {
+    if (path.empty()) return cout;
+    file.open(path, ios::binary | ios::trunc);
+    if (!file) throw runtime_error("Cannot open output file: " + path);
+    return file;
+}
+
+string readWholeStream(istream &in) {
+    ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// ---------- Stream mode ----------
+template <int N>
+int runHillEngineStream(const CommandLineOptions &options) {
+    using Engine = HillEngine<N>;
+    typename Engine::Matrix inverse = Engine::invert(Engine::keyFromString(options.keyString));
+    ifstream inputFile;
+    ofstream outputFile;
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+    ThreadPool pool(options.threadCount);
+    Engine::streamDecrypt(in, out, inverse, options.chunkSize, pool, options.threadCount);
+    return 0;
+}
+
+template <int N>
+int runAlphabetStream(const CommandLineOptions &options, const Alphabet &alphabet) {
+    using Engine = HillEngine<N>;
+    int m = alphabet.size();
+    ModulusContext context = ModulusContext::forModulus(m, (uint32_t)(N * (m - 1) * (m - 1)));
+    // a bytes key is given as 2 * N * N hex digits
+    string keyString = alphabet.name == "bytes" ? hexToBytes(options.keyString) : options.keyString;
+    typename Engine::Matrix inverse = Engine::invert(Engine::keyFromSymbols(keyString, alphabet), context);
+    ifstream inputFile;
+    ofstream outputFile;
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+    ThreadPool pool(options.threadCount);
+    Engine::streamDecryptSymbols(in, out, inverse, alphabet, context, options.chunkSize, pool, options.threadCount);
+    return 0;
+}
+
+int runStreamMode(const CommandLineOptions &options) {
+    Alphabet alphabet = Alphabet::fromName(options.alphabetName);
+    if (alphabet.name != "letters") {
+        switch (options.blockSize) {
+            case 2: return runAlphabetStream<2>(options, alphabet);
+            case 3: return runAlphabetStream<3>(options, alphabet);
+            case 4: return runAlphabetStream<4>(options, alphabet);
+            case 5: return runAlphabetStream<5>(options, alphabet);
+            case 6: return runAlphabetStream<6>(options, alphabet);
+            case 7: return runAlphabetStream<7>(options, alphabet);
+            case 8: return runAlphabetStream<8>(options, alphabet);
+        }
+    }
+    switch (options.blockSize) {
+        case 2: return runHillEngineStream<2>(options);
+        case 4: return runHillEngineStream<4>(options);
+        case 5: return runHillEngineStream<5>(options);
+        case 6: return runHillEngineStream<6>(options);
+        case 7: return runHillEngineStream<7>(options);
+        case 8: return runHillEngineStream<8>(options);
+    }
+    Matrix3x3 inverseKey = invertKeyMatrixMod26UsingCrt(createKeyMatrixFromString(options.keyString));
+
+    ifstream inputFile;
+    ofstream outputFile;
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+
+    // streams from stdin have unknown length and are treated as large
+    size_t expectedBlocks = SIZE_MAX;
+    if (!options.inputPath.empty()) {
+        error_code ec;
+        uintmax_t fileSize = filesystem::file_size(options.inputPath, ec);
+        if (!ec) expectedBlocks = (size_t)(fileSize / 3);
+    }
+    PreparedInverseKey key = prepareInverseKey(inverseKey, expectedBlocks, options.engine);
+    streamDecryptCiphertext(in, out, key, options.chunkSize, options.threadCount);
+    return 0;
+}
+
+// ---------- Memory-mapped mode ----------
+int runMmapMode(const CommandLineOptions &options) {
+    Matrix3x3 inverseKey = invertKeyMatrixMod26UsingCrt(createKeyMatrixFromString(options.keyString));
+    MappedDecryptStats stats = decryptFileMemoryMapped(options.inputPath, options.outputPath, inverseKey,
+                                                       options.hugePages, options.engine, options.threadCount);
+    double bytesPerSecond = stats.seconds > 0 ? stats.inputBytes / stats.seconds : 0.0;
+    cerr << "Decrypted " << stats.inputBytes << " input bytes into " << stats.outputBytes
+         << " plaintext letters in " << fixed << setprecision(3) << stats.seconds << " s ("
+         << setprecision(1) << bytesPerSecond / 1e6 << " MB/s)\n";
+    return 0;
+}
+
+// ---------- Batch inversion modes ----------
+void reportInversionRate(size_t keyCount, size_t invertibleCount, double seconds) {
+    cerr << "Inverted " << keyCount << " keys (" << invertibleCount << " invertible) in " << fixed
+         << setprecision(4) << seconds << " s (" << setprecision(1)
+         << (seconds > 0 ? keyCount / seconds / 1e6 : 0.0) << " million keys/s)\n";
+}
+
+int runInvertKeysMode(const CommandLineOptions &options) {
+    ifstream inputFile;
+    ofstream outputFile;
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+
+    // malformed lines are kept as all-zero (singular) keys so output stays line-aligned
+    vector<Matrix3x3> keys;
+    vector<bool> wellFormed;
+    string line;
+    while (getline(in, line)) {
+        string cleaned = keepLettersUpper(line);
+        Matrix3x3 key{};
+        if (cleaned.size() == 9) key = createKeyMatrixFromString(cleaned);
+        keys.push_back(key);
+        wellFormed.push_back(cleaned.size() == 9);
+    }
+
+    vector<Matrix3x3> inverses(keys.size());
+    vector<uint64_t> status((keys.size() + 63) / 64);
+    auto startTime = chrono::steady_clock::now();
+    size_t invertibleCount = invertKeyMatricesBatch(keys.data(), keys.size(), inverses.data(), status.data());
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (!wellFormed[i]) out << "invalid\n";
+        else if (status[i / 64] >> (i % 64) & 1) out << matrixToKeyString(inverses[i]) << "\n";
+        else out << "-\n";
+    }
+    out.flush();
+    reportInversionRate(keys.size(), invertibleCount, seconds);
+    return 0;
+}
+
+int runBenchInvertMode(const CommandLineOptions &options) {
+    size_t count = options.benchCount;
+    vector<Matrix3x3> keys(count), inverses(count);
+    vector<uint64_t> status((count + 63) / 64);
+    mt19937_64 rng(12345);
+    for (Matrix3x3 &key : keys)
+        for (auto &row : key)
+            for (int &entry : row) entry = (int)(rng() % MOD_26);
+
+    ThreadPool pool(options.threadCount);
+    const size_t sliceKeys = 1 << 16;   // multiple of 64, so slices never share a status word
+    size_t slices = (count + sliceKeys - 1) / sliceKeys;
+    vector<size_t> invertiblePerSlice(slices);
+    auto startTime = chrono::steady_clock::now();
+    pool.parallelFor(slices, [&](size_t s) {
+        size_t begin = s * sliceKeys, end = min(count, begin + sliceKeys);
+        invertiblePerSlice[s] = invertKeyMatricesBatch(keys.data() + begin, end - begin,
+                                                       inverses.data() + begin, status.data() + begin / 64);
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    reportInversionRate(count, accumulate(invertiblePerSlice.begin(), invertiblePerSlice.end(), (size_t)0), seconds);
+    return 0;
+}
+
+// Prints the inverse as N lines of N letters; timing and a K * (K^-1 * x) == x check go to stderr
+int runInvertLargeMode(const CommandLineOptions &options) {
+    ifstream inputFile;
+    ofstream outputFile;
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+    size_t n = options.largeKeySize;
+    LargeKeyMatrix key = largeKeyFromString(readWholeStream(in), n), inverse;
+
+    ThreadPool pool(options.threadCount);
+    LargeInversionTiming timing;
+    if (!tryInvertLargeKeyMod26(key, inverse, pool, &timing))
+        throw runtime_error("Key matrix is not invertible mod 26 (singular mod 2 or mod 13).");
+
+    mt19937_64 rng(12345);
+    vector<int> x(n), y(n, 0);
+    for (int &v : x) v = (int)(rng() % MOD_26);
+    bool verified = true;
+    for (size_t r = 0; r < n; ++r)
+        for (size_t c = 0; c < n; ++c) y[r] = (y[r] + inverse.at(r, c) * x[c]) % MOD_26;
+    for (size_t r = 0; r < n && verified; ++r) {
+        int sum = 0;
+        for (size_t c = 0; c < n; ++c) sum = (sum + key.at(r, c) * y[c]) % MOD_26;
+        verified = sum == x[r];
+    }
+    if (!verified) throw runtime_error("Large-key inverse failed verification.");
+
+    string line(n, 'A');
+    for (size_t r = 0; r < n; ++r) {
+        for (size_t c = 0; c < n; ++c) line[c] = ALPHABET[inverse.at(r, c)];
+        out << line << "\n";
+    }
+    cerr << "Inverted " << n << "x" << n << " key in " << fixed << setprecision(2)
+         << (timing.mod2Seconds + timing.mod13Seconds) * 1e3 << " ms (mod 2: " << timing.mod2Seconds * 1e3
+         << " ms, mod 13: " << timing.mod13Seconds * 1e3 << " ms), verified\n";
+    return 0;
+}
+
+// ---------- Keyed message mode ----------
+// Decrypts a message log in batches of lines; lines of a batch run on the thread pool and share
+// the inverse-key cache, and results are written in input order.
+const size_t KEYED_MESSAGE_BATCH_LINES = 4096;
+
+int runKeyedMessagesMode(const CommandLineOptions &options) {
+    ifstream inputFile;
+    ofstream outputFile;
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+
+    InverseKeyCache cache(options.cacheBytes, options.engine);
+    ThreadPool pool(options.threadCount);
+    vector<string> lines, results;
+    bool more = true;
+    while (more) {
+        lines.clear();
+        string line;
+        while (lines.size() < KEYED_MESSAGE_BATCH_LINES && (more = (bool)getline(in, line))) lines.push_back(line);
+        results.assign(lines.size(), string());
+        pool.parallelFor(lines.size(), [&](size_t i) {
+            size_t tab = lines[i].find('\t');
+            if (tab == string::npos) {
+                results[i] = "ERROR: expected KEY<TAB>ciphertext";
+                return;
+            }
+            try {
+                shared_ptr<const PreparedInverseKey> key = cache.get(lines[i].substr(0, tab));
+                results[i] = decryptCiphertextWithKeyInverse(lines[i].substr(tab + 1), *key);
+            } catch (const exception &ex) {
+                results[i] = string("ERROR: ") + ex.what();
+            }
+        });
+        for (const string &result : results) out << result << "\n";
+    }
+    out.flush();
+
+    KeyCacheStats stats = cache.stats();
+    cerr << "Key cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions
+         << " evictions, " << stats.entries << " entries (" << stats.bytes << " bytes)\n";
+    return 0;
+}
+
+// ---------- Known-plaintext mode ----------
+const size_t MAX_RANKED_CRIB_KEYS = 1 << 20;
+const size_t FITNESS_PREFIX_BLOCKS = 400;
+const size_t PREVIEW_LETTERS = 40;
+
+string previewPlaintext(const vector<uint8_t> &cipher, const Matrix3x3 &inverse) {
+    size_t blocks = min(cipher.size() / 3, PREVIEW_LETTERS / 3);
+    string letters(3 * blocks, 'A');
+    for (size_t i = 0; i < letters.size(); ++i) letters[i] = ALPHABET[cipher[i]];
+    string plain(letters.size(), 'A');
+    decryptBlocksToBuffer(letters.data(), blocks, inverse, &plain[0]);
+    return plain;
+}
+
+void printRankedKeys(ostream &out, const vector<RankedKey> &ranked, size_t topCount, const vector<uint8_t> &cipher) {
+    for (size_t i = 0; i < ranked.size() && i < topCount; ++i) {
+        const RankedKey &entry = ranked[i];
+        out << matrixToKeyString(entry.key) << "  inverse " << matrixToKeyString(entry.inverse);
+        if (entry.occurrences) out << "  count " << entry.occurrences << "  offset " << entry.firstOffset;
+        out << "  fitness " << fixed << setprecision(3) << entry.fitness << "  " << previewPlaintext(cipher, entry.inverse)
+            << "\n";
+    }
+    out.flush();
+}
+
+int runKnownPlaintextMode(const CommandLineOptions &options) {
+    ifstream inputFile;
+    ofstream outputFile;
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+    vector<uint8_t> cipher = letterIndices(readWholeStream(in));
+    vector<uint8_t> cribLetters = letterIndices(options.crib);
+
+    // drop leading crib letters until the crib starts on a block boundary
+    size_t skip = (3 - options.cribOffset % 3) % 3;
+    if (cribLetters.size() < skip + 9) throw runtime_error("Crib must cover at least 3 whole blocks.");
+    if (options.cribOffset + cribLetters.size() > cipher.size()) throw runtime_error("Crib runs past the ciphertext.");
+    cribLetters.erase(cribLetters.begin(), cribLetters.begin() + skip);
+
+    auto startTime = chrono::steady_clock::now();
+    CribSystem crib = buildCribSystem(cribLetters);
+    if (crib.candidatesPerPlacement[0] * crib.candidatesPerPlacement[1] > MAX_RANKED_CRIB_KEYS)
+        throw runtime_error("Crib leaves too many candidate keys; use a longer crib.");
+    vector<Matrix3x3> keysMod2, keysMod13, keys;
+    solveKeysFromCrib(crib, cipher.data() + options.cribOffset + skip, keysMod2, keysMod13, keys);
+    if (keys.empty())
+        throw runtime_error("No invertible key maps the crib onto the ciphertext at offset "
+                            + to_string(options.cribOffset) + ".");
+
+    // a short crib can leave several keys; rank them by how English the start of the message reads
+    ThreadPool pool(options.threadCount);
+    vector<RankedKey> ranked(keys.size());
+    size_t scoredBlocks = min(cipher.size() / 3, FITNESS_PREFIX_BLOCKS);
+    pool.parallelFor(keys.size(), [&](size_t i) {
+        ranked[i].key = keys[i];
+        tryInvertKeyMatrixMod26(keys[i], ranked[i].inverse);
+        ranked[i].fitness = englishFitness(cipher.data(), scoredBlocks, ranked[i].inverse);
+    });
+    sort(ranked.begin(), ranked.end(), [](const RankedKey &a, const RankedKey &b) { return a.fitness > b.fitness; });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    printRankedKeys(out, ranked, options.topCount, cipher);
+    cerr << "Crib of " << crib.blockCount << " blocks spans rank " << crib.rank[0] << " mod 2 and rank "
+         << crib.rank[1] << " mod 13; " << keys.size() << " consistent key(s) in " << fixed << setprecision(3)
+         << seconds * 1e3 << " ms\n";
+    return 0;
+}
+
+// ---------- Crib-drag mode ----------
+// Tries the crib at every ciphertext letter offset. Offsets sharing a phase (offset mod 3) share
+// one CribSystem; placements are split into slices run on the thread pool, and each slice
+// tallies its surviving keys before they are merged and ranked by English fitness, then count.
+// Where the aligned crib has no blocks beyond those that fix the key, every placement yields a
+// key; those are screened by the fitness of a short message prefix instead (English scores about
+// -2.9 there, wrong keys about -3.6 with a spread of roughly 0.09 over 64 blocks).
+const size_t CRIB_DRAG_SLICE_OFFSETS = 1 << 16;
+const size_t FITNESS_SCREEN_BLOCKS = 64;
+const double FITNESS_SCREEN_THRESHOLD = -3.25;
+
+struct CribDragTally {
+    unordered_map<string, RankedKey> keys;
+    uint64_t rejectedMod2 = 0, rejectedMod13 = 0;
+};
+
+void tallyCribKey(CribDragTally &tally, const Matrix3x3 &key, size_t offset) {
+    RankedKey &entry = tally.keys[matrixToKeyString(key)];
+    if (entry.occurrences == 0 || offset < entry.firstOffset) {
+        entry.key = key;
+        entry.firstOffset = offset;
+    }
+    ++entry.occurrences;
+}
+
+int runCribDragMode(const CommandLineOptions &options) {
+    ifstream inputFile;
+    ofstream outputFile;
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+    vector<uint8_t> cipher = letterIndices(readWholeStream(in));
+    vector<uint8_t> cribLetters = letterIndices(options.crib);
+    if (cribLetters.size() > cipher.size()) throw runtime_error("Crib is longer than the ciphertext.");
+
+    vector<CribSystem> systems(3);
+    bool usable[3], screened[3];
+    for (size_t phase = 0; phase < 3; ++phase) {
+        size_t skip = (3 - phase) % 3;
+        usable[phase] = false;
+        if (cribLetters.size() >= skip + 9) {
+            try {
+                systems[phase] = buildCribSystem(vector<uint8_t>(cribLetters.begin() + skip, cribLetters.end()));
+                const CribSystem &crib = systems[phase];
+                usable[phase] = crib.candidatesPerPlacement[0] * crib.candidatesPerPlacement[1] <= MAX_RANKED_CRIB_KEYS;
+                screened[phase] = crib.blockCount <= (size_t)crib.rank[1];
+            } catch (const runtime_error &) {}
+        }
+        if (!usable[phase]) cerr << "Skipping offsets = " << phase << " (mod 3): crib too short there\n";
+    }
+    if (!usable[0] && !usable[1] && !usable[2]) throw runtime_error("Crib is too short for any placement.");
+    size_t screenBlocks = min(cipher.size() / 3, FITNESS_SCREEN_BLOCKS);
+
+    auto startTime = chrono::steady_clock::now();
+    ThreadPool pool(options.threadCount);
+    size_t placements = cipher.size() - cribLetters.size() + 1;
+    size_t slices = (placements + CRIB_DRAG_SLICE_OFFSETS - 1) / CRIB_DRAG_SLICE_OFFSETS;
+    vector<CribDragTally> tallies(slices);
+    pool.parallelFor(slices, [&](size_t s) {
+        CribDragTally &tally = tallies[s];
+        vector<Matrix3x3> keysMod2, keysMod13, keys;
+        size_t end = min(placements, (s + 1) * CRIB_DRAG_SLICE_OFFSETS);
+        for (size_t offset = s * CRIB_DRAG_SLICE_OFFSETS; offset < end; ++offset) {
+            size_t phase = offset % 3;
+            if (!usable[phase]) continue;
+            solveKeysFromCrib(systems[phase], cipher.data() + offset + (3 - phase) % 3, keysMod2, keysMod13, keys);
+            if (keysMod2.empty()) ++tally.rejectedMod2;
+            else if (keys.empty()) ++tally.rejectedMod13;
+            for (const Matrix3x3 &key : keys) {
+                Matrix3x3 inverse;
+                if (screened[phase] && (!tryInvertKeyMatrixMod26(key, inverse)
+                                        || englishFitness(cipher.data(), screenBlocks, inverse) < FITNESS_SCREEN_THRESHOLD))
+                    continue;
+                tallyCribKey(tally, key, offset);
+            }
+        }
+    });
+
+    CribDragTally merged;
+    for (CribDragTally &tally : tallies) {
+        merged.rejectedMod2 += tally.rejectedMod2;
+        merged.rejectedMod13 += tally.rejectedMod13;
+        for (auto &entry : tally.keys) {
+            RankedKey &target = merged.keys[entry.first];
+            if (target.occurrences == 0 || entry.second.firstOffset < target.firstOffset) {
+                target.key = entry.second.key;
+                target.firstOffset = entry.second.firstOffset;
+            }
+            target.occurrences += entry.second.occurrences;
+        }
+    }
+    vector<RankedKey> ranked;
+    for (auto &entry : merged.keys) ranked.push_back(entry.second);
+    size_t scoredBlocks = min(cipher.size() / 3, FITNESS_PREFIX_BLOCKS);
+    pool.parallelFor(ranked.size(), [&](size_t i) {
+        tryInvertKeyMatrixMod26(ranked[i].key, ranked[i].inverse);
+        ranked[i].fitness = englishFitness(cipher.data(), scoredBlocks, ranked[i].inverse);
+    });
+    sort(ranked.begin(), ranked.end(), [](const RankedKey &a, const RankedKey &b) {
+        if (a.fitness != b.fitness) return a.fitness > b.fitness;
+        return a.occurrences > b.occurrences;
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    printRankedKeys(out, ranked, options.topCount, cipher);
+    cerr << "Dragged crib over " << placements << " offsets in " << fixed << setprecision(3) << seconds
+         << " s: " << merged.rejectedMod2 << " rejected mod 2, " << merged.rejectedMod13 << " rejected mod 13, "
+         << ranked.size() << " distinct key(s)\n";
+    return 0;
+}
+
+// ---------- Row attack mode ----------
+// prefix holds the first letters of the message, for bigram ranking and previews
+vector<RankedKey> attackRows(const BlockHistogram &histogram, const vector<uint8_t> &prefix,
+                             const CommandLineOptions &options, ThreadPool &pool) {
+    vector<RowCandidate> rows = options.fullRowSearch ? bestRows(scoreInverseRows(histogram, pool), options.topRows)
+                                                      : searchRowsCrt(histogram, options.topRows, pool);
+    return assembleRowKeys(rows, prefix, pool);
+}
+
+// One ciphertext per input line; messages run in parallel, each attacked on a single thread, and
+// the best key per message is written on the matching output line ('-' when none is found)
+int runAttackRowsBatch(const CommandLineOptions &options, istream &in, ostream &out) {
+    vector<string> messages;
+    string line;
+    while (getline(in, line)) messages.push_back(line);
+
+    auto startTime = chrono::steady_clock::now();
+    ThreadPool pool(options.threadCount);
+    vector<string> results(messages.size());
+    pool.parallelFor(messages.size(), [&](size_t i) {
+        vector<uint8_t> cipher = letterIndices(messages[i]);
+        ThreadPool serial(1);
+        vector<uint8_t> prefix(cipher.begin(), cipher.begin() + min(cipher.size() / 3, FITNESS_PREFIX_BLOCKS) * 3);
+        vector<RankedKey> ranked;
+        if (cipher.size() >= 3) ranked = attackRows(buildBlockHistogram(cipher), prefix, options, serial);
+        if (ranked.empty()) {
+            results[i] = "-";
+            return;
+        }
+        ostringstream result;
+        printRankedKeys(result, ranked, 1, cipher);
+        results[i] = result.str();
+        results[i].pop_back();
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    for (const string &result : results) out << result << "\n";
+    out.flush();
+    cerr << "Attacked " << messages.size() << " messages in " << fixed << setprecision(3) << seconds << " s ("
+         << setprecision(1) << (seconds > 0 ? messages.size() / seconds : 0.0) << " messages/s)\n";
+    return 0;
+}
+
+int runAttackRowsMode(const CommandLineOptions &options) {
+    ifstream inputFile;
+    ofstream outputFile;
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+    if (options.batch) return runAttackRowsBatch(options, in, out);
+
+    // the message is read in chunks straight into the histogram, so its size is not limited by memory
+    auto startTime = chrono::steady_clock::now();
+    BlockHistogramBuilder builder;
+    vector<uint8_t> prefix;
+    vector<char> chunk(DEFAULT_STREAM_CHUNK_SIZE);
+    while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0) {
+        vector<uint8_t> letters = letterIndices(string(chunk.data(), (size_t)in.gcount()));
+        builder.add(letters.data(), letters.size());
+        size_t wanted = 3 * FITNESS_PREFIX_BLOCKS - prefix.size();
+        prefix.insert(prefix.end(), letters.begin(), letters.begin() + min(wanted, letters.size()));
+    }
+    BlockHistogram histogram = builder.finish();
+    if (histogram.blockCount == 0) throw runtime_error("Ciphertext must contain at least one block.");
+    prefix.resize(prefix.size() / 3 * 3);
+    double histogramSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    ThreadPool pool(options.threadCount);
+    vector<RankedKey> ranked = attackRows(histogram, prefix, options, pool);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count() - histogramSeconds;
+
+    printRankedKeys(out, ranked, options.topCount, prefix);
+    cerr << "Histogram of " << histogram.blockCount << " blocks (" << histogram.blocks.size() << " distinct) in "
+         << fixed << setprecision(3) << histogramSeconds * 1e3 << " ms; searched rows ("
+         << (options.fullRowSearch ? "full" : "crt") << ") and ranked " << ranked.size()
+         << " invertible row triples in " << seconds * 1e3 << " ms\n";
+    return 0;
+}
+
+// ---------- Annealing mode ----------
+QuadgramModel loadCorpusModel(const string &corpusPath) {
+    ifstream corpusFile(corpusPath, ios::binary);
+    if (!corpusFile) throw runtime_error("Cannot open corpus file: " + corpusPath);
+    return QuadgramModel::fromCorpus(corpusFile);
+}
+
+int runBuildQuadgramsMode(const CommandLineOptions &options) {
+    auto startTime = chrono::steady_clock::now();
+    loadCorpusModel(options.corpusPath).save(options.outputPath);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    cerr << "Wrote quadgram model " << options.outputPath << " in " << fixed << setprecision(2) << seconds << " s\n";
+    return 0;
+}
+
+int runAnnealMode(const CommandLineOptions &options) {
+    ifstream inputFile;
+    ofstream outputFile;
+    QuadgramModel model = options.quadgramPath.empty() ? loadCorpusModel(options.corpusPath)
+                                                       : QuadgramModel::load(options.quadgramPath);
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+    string ciphertext = readWholeStream(in);
+    vector<uint8_t> cipher = letterIndices(ciphertext);
+    if (cipher.size() < 6) throw runtime_error("Ciphertext must contain at least two blocks.");
+
+    auto startTime = chrono::steady_clock::now();
+    ThreadPool pool(options.threadCount);
+    AnnealBest best;
+    annealSearch(cipher, model, options.anneal, pool, best, cerr);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    uint64_t restarts = best.restarts.load();
+    cerr << restarts << " restarts on " << pool.size() << " thread(s) in " << fixed << setprecision(2) << seconds
+         << " s (" << setprecision(1) << (seconds > 0 ? restarts / seconds : 0.0) << " restarts/s)\n";
+    if (!best.found) throw runtime_error("No invertible key found.");
+
+    // report the fitness of the whole message, not just the scored prefix
+    RankedKey result;
+    result.inverse = best.inverse;
+    tryInvertKeyMatrixMod26(best.inverse, result.key);
+    string plaintext = decryptCiphertextWithKeyInverse(ciphertext, best.inverse);
+    result.fitness = model.scorePlaintext(plaintext) / QUADGRAM_SCALE / max<size_t>(1, plaintext.size() - 3);
+    printRankedKeys(out, { result }, 1, cipher);
+    return 0;
+}
+
+// ---------- Key library mode ----------
+const size_t KEY_LIBRARY_SLICE_KEYS = 1024;
+
+// Reads one 9-letter key per line; malformed lines are skipped
+vector<Matrix3x3> readKeyLibrary(const string &path) {
+    ifstream file(path);
+    if (!file) throw runtime_error("Cannot open key library: " + path);
+    vector<Matrix3x3> keys;
+    string line;
+    while (getline(file, line)) {
+        string cleaned = keepLettersUpper(line);
+        if (cleaned.size() == 9) keys.push_back(createKeyMatrixFromString(cleaned));
+    }
+    return keys;
+}
+
+int runKeyLibraryMode(const CommandLineOptions &options) {
+    ifstream inputFile;
+    ofstream outputFile;
+    QuadgramModel model = QuadgramModel::load(options.quadgramPath);
+    vector<Matrix3x3> keys = readKeyLibrary(options.keyLibraryPath);
+    istream &in = openInputStream(options.inputPath, inputFile);
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+    vector<uint8_t> cipher = letterIndices(readWholeStream(in));
+    size_t blockCount = cipher.size() / 3;
+    if (blockCount < 2) throw runtime_error("Ciphertext must contain at least two blocks.");
+
+    auto startTime = chrono::steady_clock::now();
+    vector<Matrix3x3> inverses(keys.size());
+    vector<uint64_t> status((keys.size() + 63) / 64);
+    size_t invertibleCount = invertKeyMatricesBatch(keys.data(), keys.size(), inverses.data(), status.data());
+
+    ThreadPool pool(options.threadCount);
+    TopKThreshold threshold(options.topCount);
+    double z = normalUpperQuantile(options.falseRejectRate);
+    size_t slices = (keys.size() + KEY_LIBRARY_SLICE_KEYS - 1) / KEY_LIBRARY_SLICE_KEYS;
+    vector<vector<RankedKey>> survivors(slices);
+    vector<uint64_t> blocksPerSlice(slices), rejectedPerSlice(slices);
+    pool.parallelFor(slices, [&](size_t s) {
+        size_t end = min(keys.size(), (s + 1) * KEY_LIBRARY_SLICE_KEYS);
+        vector<size_t> invertible;
+        for (size_t i = s * KEY_LIBRARY_SLICE_KEYS; i < end; ++i)
+            if (status[i / 64] >> (i % 64) & 1) invertible.push_back(i);
+        vector<SequentialScore> scores(invertible.size());
+        for (size_t first = 0; first < invertible.size(); first += LIBRARY_PANEL_KEYS) {
+            size_t count = min(invertible.size() - first, LIBRARY_PANEL_KEYS);
+            if (options.perKeyLibraryScan) {
+                for (size_t k = first; k < first + count; ++k) {
+                    scores[k] = scoreKeySequential(cipher.data(), blockCount, inverses[invertible[k]], model, z,
+                                                   threshold);
+                    if (!scores[k].rejected) threshold.offer(scores[k].meanScore);
+                }
+                continue;
+            }
+            scoreKeyPanelTiled(cipher.data(), blockCount, inverses.data(), &invertible[first], count, model, z,
+                               threshold, &scores[first]);
+            for (size_t k = first; k < first + count; ++k)
+                if (!scores[k].rejected) threshold.offer(scores[k].meanScore);
+        }
+        for (size_t k = 0; k < invertible.size(); ++k) {
+            size_t i = invertible[k];
+            const SequentialScore &score = scores[k];
+            blocksPerSlice[s] += score.blocksEvaluated;
+            if (score.rejected) {
+                ++rejectedPerSlice[s];
+                continue;
+            }
+            RankedKey entry;
+            entry.key = keys[i];
+            entry.inverse = inverses[i];
+            entry.fitness = score.meanScore;
+            survivors[s].push_back(entry);
+        }
+    });
+    vector<RankedKey> ranked;
+    for (vector<RankedKey> &slice : survivors) ranked.insert(ranked.end(), slice.begin(), slice.end());
+    sort(ranked.begin(), ranked.end(), [](const RankedKey &a, const RankedKey &b) { return a.fitness > b.fitness; });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    printRankedKeys(out, ranked, options.topCount, cipher);
+    uint64_t blocks = accumulate(blocksPerSlice.begin(), blocksPerSlice.end(), (uint64_t)0);
+    uint64_t rejected = accumulate(rejectedPerSlice.begin(), rejectedPerSlice.end(), (uint64_t)0);
+    cerr << "Scored " << invertibleCount << " invertible of " << keys.size() << " keys in " << fixed
+         << setprecision(3) << seconds << " s: " << rejected << " abandoned early, " << setprecision(1)
+         << (invertibleCount ? (double)blocks / invertibleCount : 0.0) << " of " << blockCount
+         << " blocks decrypted per key on average\n";
+    return 0;
+}
+
+// ---------- Key enumeration mode ----------
+// Slices of the range are enumerated in parallel, a round of slices at a time, and written in order
+const uint64_t ENUMERATION_SLICE_KEYS = 1 << 16;
+
+int runEnumerateKeysMode(const CommandLineOptions &options) {
+    ofstream outputFile;
+    ostream &out = openOutputStream(options.outputPath, outputFile);
+    if (options.rangeStart > INVERTIBLE_KEY_COUNT) throw runtime_error("Start index past the last key.");
+    uint64_t end = options.rangeStart + min(options.rangeCount, INVERTIBLE_KEY_COUNT - options.rangeStart);
+
+    auto startTime = chrono::steady_clock::now();
+    ThreadPool pool(options.threadCount);
+    size_t sliceCount = 4 * pool.size();
+    vector<string> slices(sliceCount);
+    for (uint64_t roundStart = options.rangeStart; roundStart < end; roundStart += sliceCount * ENUMERATION_SLICE_KEYS) {
+        pool.parallelFor(sliceCount, [&](size_t s) {
+            uint64_t first = roundStart + s * ENUMERATION_SLICE_KEYS;
+            uint64_t last = min(end, first + ENUMERATION_SLICE_KEYS);
+            string &text = slices[s];
+            text.clear();
+            if (first >= last) return;
+            text.reserve((last - first) * 20);
+            InvertibleKeyEnumerator keys(first);
+            Matrix3x3 key, inverse;
+            for (uint64_t i = first; i < last && keys.next(key, inverse); ++i) {
+                for (int e = 0; e < 9; ++e) text += ALPHABET[key[e / 3][e % 3]];
+                text += ' ';
+                for (int e = 0; e < 9; ++e) text += ALPHABET[inverse[e / 3][e % 3]];
+                text += '\n';
+            }
+        });
+        for (const string &text : slices) out << text;
+    }
+    out.flush();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    uint64_t produced = end - options.rangeStart;
+    cerr << "Enumerated " << produced << " of " << INVERTIBLE_KEY_COUNT << " invertible keys in " << fixed
+         << setprecision(3) << seconds << " s (" << setprecision(1) << (seconds > 0 ? produced / seconds / 1e6 : 0.0)
+         << " million keys/s)\n";
+    return 0;
+}
+
+// ---------- Gray sweep mode ----------
+// Sweeps the range in parallel slices; the XOR of all inverses is printed so the work is observable
+int runGraySweepMode(const CommandLineOptions &options) {
+    if (options.rangeStart >= RAW_KEY_COUNT) throw runtime_error("Start index past the last key.");
+    uint64_t count = min(options.rangeCount, RAW_KEY_COUNT - options.rangeStart);
+
+    auto startTime = chrono::steady_clock::now();
+    ThreadPool pool(options.threadCount);
+    size_t slices = min<uint64_t>(max<uint64_t>(1, count / ENUMERATION_SLICE_KEYS), 64 * pool.size());
+    vector<uint64_t> invertiblePerSlice(slices), checksumPerSlice(slices);
+    pool.parallelFor(slices, [&](size_t s) {
+        uint64_t first = options.rangeStart + count * s / slices, last = options.rangeStart + count * (s + 1) / slices;
+        if (first >= last) return;
+        GrayCodeKeyIterator keys(first);
+        Matrix3x3 inverse;
+        uint64_t invertible = 0, checksum = 0;
+        for (uint64_t i = first; i < last; ++i) {
+            if (keys.isInvertible()) {
+                keys.inverse(inverse);
+                ++invertible;
+                for (const auto &row : inverse)
+                    for (int entry : row) checksum = checksum * 31 + entry;
+            }
+            if (i + 1 < last) keys.advance();
+        }
+        invertiblePerSlice[s] = invertible;
+        checksumPerSlice[s] = checksum;
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    uint64_t invertible = accumulate(invertiblePerSlice.begin(), invertiblePerSlice.end(), (uint64_t)0);
+    uint64_t checksum = 0;
+    for (uint64_t sliceChecksum : checksumPerSlice) checksum ^= sliceChecksum;
+    cout << "Swept " << count << " keys from index " << options.rangeStart << ": " << invertible
+         << " invertible, inverse checksum " << hex << checksum << dec << "\n";
+    cerr << fixed << setprecision(3) << seconds << " s (" << setprecision(1)
+         << (seconds > 0 ? count / seconds / 1e6 : 0.0) << " million keys/s)\n";
+    return 0;
+}
+
+// ---------- Self-check ----------
+// --self-check runs the fast paths against their reference implementations on fixed, seeded
+// inputs. It prints one line per check and exits non-zero if any check fails.
+const uint64_t SELF_CHECK_SEED = 0x5EEDC0DE;
+
+struct SelfCheck {
+    ostream &out;
+    int failures = 0;
+
+    void expect(bool ok, const string &name) {
+        out << (ok ? "ok      " : "FAILED  ") << name << "\n";
+        failures += !ok;
+    }
+};
+
+// Ciphertext-like noise: runs of mixed-case letters between runs of digits, punctuation and
+// whitespace, so partition and window boundaries land inside both kinds of run
+string noisyCiphertext(size_t size, uint64_t seed) {
+    static const string noise = "0123456789 .,;:!?-'\"()\n\t";
+    mt19937_64 rng(seed);
+    string text;
+    text.reserve(size);
+    while (text.size() < size) {
+        size_t run = 1 + rng() % 12;
+        bool letters = rng() % 3 != 0;
+        for (size_t k = 0; k < run && text.size() < size; ++k) {
+            if (letters) text += (char)((rng() % 2 ? 'a' : 'A') + rng() % 26);
+            else text += noise[rng() % noise.size()];
+        }
+    }
+    return text;
+}
+
+// English plaintext for the attack checks, long enough for letter statistics to settle
+const char *const SELF_CHECK_PLAINTEXT =
+    "When the letter arrived at the station it was already late in the evening and the clerk had gone "
+    "home, so the message waited on the desk until morning. Nobody could read it. The words were only "
+    "groups of three letters, and the groups made no sense at all when read aloud. The old officer who "
+    "opened the office the next day knew at once that it had been written with a matrix, because the "
+    "same letter never turned into the same letter twice. He remembered that the method had been "
+    "described by a teacher of mathematics many years before, and that the teacher had even built a "
+    "machine with gears to do the work. The officer took out a pencil and a sheet of paper and began to "
+    "count how often each group of letters appeared in the message. Some groups came back again and "
+    "again, and he guessed that they stood for common words such as the and and, which appear in almost "
+    "every sentence that people write. By the afternoon he had found two rows of the key, and by the "
+    "evening he could read the whole letter. It asked for more supplies to be sent before the winter, "
+    "and for the men at the border to be told that the bridge over the river would be closed for repairs "
+    "until the spring.";
+
+string streamDecryptToString(const string &input, const PreparedInverseKey &key, size_t chunkSize, unsigned threads) {
+    istringstream in(input);
+    ostringstream out;
+    streamDecryptCiphertext(in, out, key, chunkSize, threads);
+    return out.str();
+}
+
+// Windowed decryption on several threads must match one thread and the one-shot reference, with
+// every supported kernel and decode engine
+void checkThreadedWindows(SelfCheck &check) {
+    const size_t inputSize = 6 << 20;
+    string input = noisyCiphertext(inputSize, SELF_CHECK_SEED);
+    Matrix3x3 inverse = invertKeyMatrixMod26UsingCrt(createKeyMatrixFromString("GYBNQKURP"));
+    const DecryptKernel *original = &activeDecryptKernel();
+    for (const DecryptKernel &kernel : decryptKernels()) {
+        if (!kernel.isSupported()) continue;
+        activeKernelSlot() = &kernel;
+        for (DecodeEngine engine : {DecodeEngine::Kernel, DecodeEngine::TrigramTable}) {
+            PreparedInverseKey key = prepareInverseKey(inverse, inputSize / 3, engine);
+            string reference = decryptCiphertextWithKeyInverse(input, key);
+            string label = string(kernel.name) + (engine == DecodeEngine::Kernel ? " kernel" : " table");
+            check.expect(streamDecryptToString(input, key, (1 << 20) + 7, 1) == reference,
+                         "stream " + label + ", 1 thread");
+            check.expect(streamDecryptToString(input, key, (1 << 20) + 7, 4) == reference,
+                         "stream " + label + ", 4 threads");
+        }
+    }
+    activeKernelSlot() = original;
+}
+
+// Every compaction kernel must produce the scalar kernel's letters and count, and never store at
+// or past out + size, on inputs whose letter runs end anywhere within a register
+void checkCompactionKernels(SelfCheck &check) {
+    const char GUARD = '#';
+    mt19937_64 rng(SELF_CHECK_SEED);
+    vector<string> inputs;
+    for (size_t size : {0, 1, 15, 16, 17, 63, 64, 65, 200, 4099}) inputs.push_back(noisyCiphertext(size, rng()));
+    inputs.push_back(string(300, 'q'));
+    inputs.push_back(string(300, '.'));
+    for (const DecryptKernel &kernel : decryptKernels()) {
+        if (!kernel.isSupported()) continue;
+        bool ok = true;
+        for (const string &input : inputs) {
+            vector<char> expected(input.size() + 1), out(input.size() + 64, GUARD);
+            size_t expectedCount = compactLettersUpperScalar(input.data(), input.size(), expected.data());
+            size_t count = kernel.compactLetters(input.data(), input.size(), out.data());
+            ok = ok && count == expectedCount && equal(out.begin(), out.begin() + count, expected.begin())
+                 && all_of(out.begin() + input.size(), out.end(), [&](char ch) { return ch == GUARD; });
+        }
+        check.expect(ok, string("compaction ") + kernel.name + " matches scalar within out[0..size)");
+    }
+}
+
+// Every block kernel must match the scalar kernel on all 26^3 blocks, including partial vectors
+void checkBlockKernels(SelfCheck &check) {
+    string cipher;
+    for (int code = 0; code < TRIGRAM_COUNT; ++code)
+        cipher += {(char)('A' + code / 676), (char)('A' + code / 26 % 26), (char)('A' + code % 26)};
+    Matrix3x3 inverse = invertKeyMatrixMod26UsingCrt(createKeyMatrixFromString("GYBNQKURP"));
+    string expected(cipher.size(), '\0');
+    decryptBlocksScalar(cipher.data(), TRIGRAM_COUNT, inverse, &expected[0]);
+    for (const DecryptKernel &kernel : decryptKernels()) {
+        if (!kernel.isSupported()) continue;
+        bool ok = true;
+        for (size_t blockCount : {(size_t)TRIGRAM_COUNT, (size_t)TRIGRAM_COUNT - 1, (size_t)77, (size_t)1}) {
+            string out(3 * blockCount, '\0');
+            kernel.decryptBlocks(cipher.data(), blockCount, inverse, &out[0]);
+            ok = ok && out == expected.substr(0, out.size());
+        }
+        check.expect(ok, string("block kernel ") + kernel.name + " matches scalar on every block");
+    }
+}
+
+// SELF_CHECK_PLAINTEXT as whole blocks of letter indices, and its encryption under key
+void encryptSelfCheckPlaintext(const Matrix3x3 &key, vector<uint8_t> &plain, vector<uint8_t> &cipher) {
+    plain = letterIndices(SELF_CHECK_PLAINTEXT);
+    plain.resize(plain.size() / 3 * 3);
+    cipher.clear();
+    for (size_t b = 0; b < plain.size(); b += 3)
+        for (int r = 0; r < 3; ++r)
+            cipher.push_back((uint8_t)((key[r][0] * plain[b] + key[r][1] * plain[b + 1] + key[r][2] * plain[b + 2]) % MOD_26));
+}
+
+// Annealing with a quadgram model built from the plaintext itself must find the key within its
+// restart budget
+void checkAnnealRecovery(SelfCheck &check) {
+    Matrix3x3 key = createKeyMatrixFromString("GYBNQKURP");
+    vector<uint8_t> plain, cipher;
+    encryptSelfCheckPlaintext(key, plain, cipher);
+    istringstream corpus(SELF_CHECK_PLAINTEXT);
+    QuadgramModel model = QuadgramModel::fromCorpus(corpus);
+    AnnealSettings settings;
+    settings.seconds = 30;
+    settings.maxRestarts = 40;
+    ThreadPool pool(1);
+    AnnealBest best;
+    ostringstream telemetry;
+    annealSearch(cipher, model, settings, pool, best, telemetry);
+    Matrix3x3 found;
+    check.expect(best.found && tryInvertKeyMatrixMod26(best.inverse, found) && found == key,
+                 "anneal recovers GYBNQKURP from " + to_string(cipher.size()) + " letters in "
+                 + to_string(best.restarts.load()) + " restarts");
+}
+
+// A batch with entries outside 0..25 must match the scalar inversion lane by lane, with and
+// without the AVX-512 kernel
+void checkKeyBatchInversion(SelfCheck &check) {
+    const char *keyTexts[] = {"GYBNQKURP", "HILLCIPHR", "PLMOKNIJB", "TRKXQPBHW"};
+    Matrix3x3 keys[KEY_BATCH_LANES];
+    for (int l = 0; l < KEY_BATCH_LANES; ++l) keys[l] = createKeyMatrixFromString(keyTexts[l % 4]);
+    keys[1][0][0] -= 2 * MOD_26;
+    keys[6][2][1] = -7;
+    keys[9][1][1] += 38 * MOD_26;
+    keys[9][2][2] += 38 * MOD_26;
+    keys[14][0][2] = 99;
+    Matrix3x3 expected[KEY_BATCH_LANES];
+    uint32_t expectedMask = 0;
+    for (int l = 0; l < KEY_BATCH_LANES; ++l) {
+        expected[l] = Matrix3x3{};
+        expectedMask |= (uint32_t)tryInvertKeyMatrixMod26(keys[l], expected[l]) << l;
+    }
+    auto matches = [&](uint32_t mask, const Matrix3x3 *inverses) {
+        return mask == expectedMask && equal(inverses, inverses + KEY_BATCH_LANES, expected);
+    };
+    Matrix3x3 inverses[KEY_BATCH_LANES];
+    check.expect(matches(invertKeyLanesPortable(keys, inverses), inverses),
+                 "portable key batch with out-of-range entries matches scalar inversion");
+#ifdef HILL_HAVE_X86_KERNELS
+    if (cpuSupportsAvx512Bw())
+        check.expect(matches(invertKeyLanesAvx512(keys, inverses), inverses),
+                     "avx512 key batch with out-of-range entries matches scalar inversion");
+#endif
+}
+
+// A crib placed where it was encrypted must yield the key; placed one block later it must yield none
+void checkCribRecovery(SelfCheck &check) {
+    Matrix3x3 key = createKeyMatrixFromString("GYBNQKURP");
+    vector<uint8_t> plain, cipher;
+    encryptSelfCheckPlaintext(key, plain, cipher);
+    const size_t offset = 300, cribLength = 30;
+    CribSystem crib = buildCribSystem(vector<uint8_t>(plain.begin() + offset, plain.begin() + offset + cribLength));
+    vector<Matrix3x3> keysMod2, keysMod13, keys;
+    solveKeysFromCrib(crib, cipher.data() + offset, keysMod2, keysMod13, keys);
+    check.expect(keys.size() == 1 && keys[0] == key, "crib of " + to_string(cribLength) + " letters at offset "
+                                                     + to_string(offset) + " solves to GYBNQKURP alone");
+    solveKeysFromCrib(crib, cipher.data() + offset + 3, keysMod2, keysMod13, keys);
+    check.expect(keys.empty(), "the same crib one block later solves to no key");
+}
+
+// The row attack, with either row search, must rank the key first on the English text alone
+void checkRowAttack(SelfCheck &check) {
+    Matrix3x3 key = createKeyMatrixFromString("GYBNQKURP");
+    vector<uint8_t> plain, cipher;
+    encryptSelfCheckPlaintext(key, plain, cipher);
+    BlockHistogram histogram = buildBlockHistogram(cipher);
+    vector<uint8_t> prefix(cipher.begin(), cipher.begin() + min(cipher.size(), 3 * FITNESS_PREFIX_BLOCKS));
+    ThreadPool pool(2);
+    for (bool fullRowSearch : {false, true}) {
+        CommandLineOptions options;
+        options.fullRowSearch = fullRowSearch;
+        vector<RankedKey> ranked = attackRows(histogram, prefix, options, pool);
+        check.expect(!ranked.empty() && ranked[0].key == key, string("row attack (") + (fullRowSearch ? "full" : "crt")
+                                                              + ") ranks GYBNQKURP first");
+    }
+}
+
+// HillEngine<N>::tryInvert over moduli with square, prime-power and large factors: every inverse
+// found must satisfy K K^-1 = I, and a stream encrypted mod an alphabet size must decrypt back
+template <int N>
+void checkModularInversion(SelfCheck &check, int modulus, mt19937_64 &rng) {
+    using Engine = HillEngine<N>;
+    ModulusContext context = ModulusContext::forModulus(modulus, 0);
+    size_t invertible = 0, trials = 0;
+    bool ok = true;
+    double microseconds = 0;
+    while (invertible < 50 && trials < 5000) {
+        typename Engine::Matrix key, inverse;
+        for (auto &row : key)
+            for (int &entry : row) entry = (int)(rng() % modulus);
+        ++trials;
+        auto startTime = chrono::steady_clock::now();
+        bool found = Engine::tryInvert(key, context, inverse);
+        microseconds += chrono::duration<double, micro>(chrono::steady_clock::now() - startTime).count();
+        if (!found) continue;
+        ++invertible;
+        for (int r = 0; r < N; ++r)
+            for (int c = 0; c < N; ++c) {
+                long long sum = 0;
+                for (int j = 0; j < N; ++j) sum += 1LL * key[r][j] * inverse[j][c];
+                ok = ok && sum % modulus == (r == c);
+            }
+    }
+    ostringstream label;
+    label << N << "x" << N << " keys mod " << modulus << ": " << invertible << " of " << trials
+          << " invertible, inverses verified (" << fixed << setprecision(2) << microseconds / trials << " us per key)";
+    check.expect(ok && invertible > 0, label.str());
+}
+
+template <int N>
+void checkAlphabetRoundTrip(SelfCheck &check, const string &alphabetName, mt19937_64 &rng) {
+    using Engine = HillEngine<N>;
+    Alphabet alphabet = Alphabet::fromName(alphabetName);
+    int m = alphabet.size();
+    ModulusContext context = ModulusContext::forModulus(m, (uint32_t)(N * (m - 1) * (m - 1)));
+    typename Engine::Matrix key, inverse;
+    do {
+        for (auto &row : key)
+            for (int &entry : row) entry = (int)(rng() % m);
+    } while (!Engine::tryInvert(key, context, inverse));
+    string plaintext, ciphertext;
+    for (size_t i = 0; i < N * 4099; ++i) plaintext += alphabet.symbols[rng() % m];
+    for (size_t b = 0; b < plaintext.size(); b += N)
+        for (int r = 0; r < N; ++r) {
+            int sum = 0;
+            for (int j = 0; j < N; ++j) sum += key[r][j] * alphabet.index[(unsigned char)plaintext[b + j]];
+            ciphertext += alphabet.symbols[sum % m];
+        }
+    istringstream in(ciphertext);
+    ostringstream out;
+    ThreadPool pool(2);
+    Engine::streamDecryptSymbols(in, out, inverse, alphabet, context, 1000, pool, 2);
+    check.expect(out.str() == plaintext, "stream round trip over " + alphabetName + " (" + to_string(m) + " symbols), "
+                                         + to_string(N) + "x" + to_string(N) + " key");
+}
+
+int runSelfCheckMode() {
+    SelfCheck check{cout};
+    checkBlockKernels(check);
+    checkCompactionKernels(check);
+    checkThreadedWindows(check);
+    checkAnnealRecovery(check);
+    checkKeyBatchInversion(check);
+    checkCribRecovery(check);
+    checkRowAttack(check);
+    mt19937_64 rng(SELF_CHECK_SEED);
+    for (int modulus : {26, 27, 32, 256, 1000, 59049, 65520, 65521, 65536}) {
+        checkModularInversion<2>(check, modulus, rng);
+        checkModularInversion<3>(check, modulus, rng);
+        checkModularInversion<5>(check, modulus, rng);
+        checkModularInversion<8>(check, modulus, rng);
+    }
+    checkAlphabetRoundTrip<3>(check, "ABCDEFGHIJKLMNOPQRSTUVWXYZ ", rng);
+    checkAlphabetRoundTrip<4>(check, "ABCDEFGHIJKLMNOPQRSTUVWXYZ012345", rng);
+    checkAlphabetRoundTrip<8>(check, "bytes", rng);
+    checkAlphabetRoundTrip<5>(check, "printable", rng);
+    cout << (check.failures ? to_string(check.failures) + " check(s) failed" : string("all checks passed")) << "\n";
+    return check.failures ? 1 : 0;
+}
+
+// ---------- Main interactive routine ----------
+int runInteractiveMode() {
+    cout << "Enter 9-letter key (row-major, A-Z): ";
+    string keyInput;
+    if (!getline(cin, keyInput)) {
+        cerr << "No key input provided.\n";
+        return 1;
+    }
+
+    // Validate and build key matrix
+    Matrix3x3 keyMatrix = createKeyMatrixFromString(keyInput);
+
+    cout << "Enter ciphertext (any text; non-letters ignored): ";
+    string ciphertextInput;
+    if (!getline(cin, ciphertextInput)) {
+        cerr << "No ciphertext input provided.\n";
+        return 1;
+    }
+
+    // Compute inverse key matrix modulo 26 using CRT
+    Matrix3x3 inverseKey = invertKeyMatrixMod26UsingCrt(keyMatrix);
+
+    // Decrypt and print result
+    string plaintext = decryptCiphertextWithKeyInverse(ciphertextInput, inverseKey);
+    cout << "Decrypted plaintext (uppercase): " << plaintext << "\n";
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    try {
+        if (argc > 1 && (string(argv[1]) == "--help" || string(argv[1]) == "-h")) {
+            printUsage(cout, argv[0]);
+            return 0;
+        }
+        CommandLineOptions options = parseCommandLine(argc, argv);
+        switch (options.mode) {
+            case RunMode::Interactive: return runInteractiveMode();
+            case RunMode::Stream: return runStreamMode(options);
+            case RunMode::Mmap: return runMmapMode(options);
+            case RunMode::ListKernels: listDecryptKernels(cout); return 0;
+            case RunMode::InvertKeys: return runInvertKeysMode(options);
+            case RunMode::BenchInvert: return runBenchInvertMode(options);
+            case RunMode::InvertLarge: return runInvertLargeMode(options);
+            case RunMode::KeyedMessages: return runKeyedMessagesMode(options);
+            case RunMode::KnownPlaintext: return runKnownPlaintextMode(options);
+            case RunMode::CribDrag: return runCribDragMode(options);
+            case RunMode::AttackRows: return runAttackRowsMode(options);
+            case RunMode::Anneal: return runAnnealMode(options);
+            case RunMode::BuildQuadgrams: return runBuildQuadgramsMode(options);
+            case RunMode::KeyLibrary: return runKeyLibraryMode(options);
+            case RunMode::EnumerateKeys: return runEnumerateKeysMode(options);
+            case RunMode::GraySweep: return runGraySweepMode(options);
+            case RunMode::SelfCheck: return runSelfCheckMode();
+        }
     }
     catch (const exception &ex) {
         cerr << "Error: " << ex.what() << "\n";